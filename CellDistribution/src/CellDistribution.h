@@ -14,23 +14,35 @@
 #ifndef CELLDISTRIBUTION_H_
 #define CELLDISTRIBUTION_H_
 #include "biodynamo.h"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include "DensityHistogram.h"
+#include "Migration.h"
+#include "ShapeAnalysis.h"
+#include "TrajectoryFile.h"
+#include "locality.h"
+#include "run_result.h"
+#include "scenario_options.h"
 
 namespace bdm {
 
-// Define my custom cell MyCell, which extends Cell by adding extra data
-// members: cell_color and can_divide
+// Define my custom cell MyCell, which extends Cell by adding the extra data
+// member migrates
 class MyCell : public Cell {  // our object extends the Cell object
                               // create the header with our new data member
-  BDM_SIM_OBJECT_HEADER(MyCell, Cell, 1,);
+  BDM_SIM_OBJECT_HEADER(MyCell, Cell, 1, migrates_);
 
  public:
   MyCell() {}
   explicit MyCell(const Double3& position) : Base(position) {}
 
-  /// If MyCell divides, daughter 2 copies the data members from the mother
+  /// If MyCell divides, daughter 2 does not migrate in this timestep
   MyCell(const Event& event, SimObject* other, uint64_t new_oid = 0)
       : Base(event, other, new_oid) {
-
+    migrates_ = false;
   }
 
   /// If a cell divides, daughter keeps the same state from its mother.
@@ -39,74 +51,217 @@ class MyCell : public Cell {  // our object extends the Cell object
     Base::EventHandler(event, other1, other2);
   }
 
+  /// Set by GrowthModule for the cells that grew in this timestep; they are
+  /// moved by the MigrationStage afterwards
+  void SetMigrates(bool migrates) { migrates_ = migrates; }
+  bool GetMigrates() const { return migrates_; }
+
+ private:
+  bool migrates_ = false;
+};
+
+/// Parameters of the simulation, read from the [scenario] section of
+/// bdm.toml or from the command line (e.g. --migration_range=4)
+struct CellDistributionScenario {
+  uint64_t steps = 500;
+  /// every timestep a growing cell moves up to migration_range along each
+  /// axis
+  double migration_range = 2;
+  double initial_diameter = 6;
+  /// simulation space is the cube [min_bound, max_bound]^3
+  double min_bound = 0;
+  double max_bound = 300;
+  /// the histograms are written every histogram_interval timesteps
+  uint64_t histogram_interval = 10;
+  int histogram_bins = 20;
+  int radial_bins = 30;
+  /// every shape_interval timesteps the shape of the tumor is analysed
+  /// (0: never); cells with less than surface_neighbors neighbors within
+  /// shape_radius are on the surface (see ShapeAnalysis)
+  uint64_t shape_interval = 10;
+  double shape_radius = 6;
+  int surface_neighbors = 6;
+  /// seed of the random walk (0: the current time, so every run differs)
+  uint64_t seed = 0;
+  /// every sort_check_interval timesteps the cells are reordered in memory
+  /// if their locality got sort_threshold times worse (see LocalityMonitor);
+  /// 0 disables the reordering
+  uint64_t sort_check_interval = 10;
+  double sort_threshold = 2;
+  /// false: nothing is written to stdout, only the CellDistributionResult is
+  /// returned (e.g. for drivers that run many scenarios in one process)
+  bool print = true;
+  /// true: the CellDistributionResult contains the final cell positions
+  /// (off by default, they are in the trajectory anyway)
+  bool keep_positions = false;
 
+  /// Reads and validates all parameters
+  static CellDistributionScenario FromOptions(ScenarioOptions* options) {
+    CellDistributionScenario scenario;
+    scenario.steps = options->GetInt("steps", scenario.steps, 1, 1e7);
+    scenario.migration_range = options->GetDouble(
+        "migration_range", scenario.migration_range, 0, 1e3);
+    scenario.initial_diameter = options->GetDouble(
+        "initial_diameter", scenario.initial_diameter, 0.1, 8);
+    scenario.min_bound =
+        options->GetDouble("min_bound", scenario.min_bound, -1e6, 1e6);
+    scenario.max_bound =
+        options->GetDouble("max_bound", scenario.max_bound, -1e6, 1e6);
+    if (scenario.min_bound >= scenario.max_bound) {
+      Log::Fatal("CellDistributionScenario",
+                 "min_bound must be smaller than max_bound");
+    }
+    scenario.histogram_interval = options->GetInt(
+        "histogram_interval", scenario.histogram_interval, 1, 1e7);
+    scenario.histogram_bins =
+        options->GetInt("histogram_bins", scenario.histogram_bins, 1, 1000);
+    scenario.radial_bins =
+        options->GetInt("radial_bins", scenario.radial_bins, 1, 1000);
+    scenario.shape_interval =
+        options->GetInt("shape_interval", scenario.shape_interval, 0, 1e7);
+    scenario.shape_radius =
+        options->GetDouble("shape_radius", scenario.shape_radius, 0.1, 1e3);
+    scenario.surface_neighbors = options->GetInt(
+        "surface_neighbors", scenario.surface_neighbors, 1, 1000);
+    scenario.seed = options->GetInt("seed", scenario.seed, 0, INT64_MAX);
+    scenario.sort_check_interval = options->GetInt(
+        "sort_check_interval", scenario.sort_check_interval, 0, 1e7);
+    scenario.sort_threshold =
+        options->GetDouble("sort_threshold", scenario.sort_threshold, 1, 1e6);
+    return scenario;
+  }
 };
 
 // Define growth behaviour
+// A small cell grows and is marked to migrate; the MigrationStage moves all
+// marked cells together after the biology modules ran.
 struct GrowthModule : public BaseBiologyModule {
   BDM_STATELESS_BM_HEADER(GrowthModule, BaseBiologyModule, 1);
 
   GrowthModule() : BaseBiologyModule(gAllEventIds) {}
 
-  /// Empty default event constructor, because GrowthModule does not have state.
   template <typename TEvent, typename TBm>
   GrowthModule(const TEvent& event, TBm* other, uint64_t new_oid = 0)
       : BaseBiologyModule(event, other, new_oid) {}
 
-
   void Run(SimObject* so) override {
     if (auto* cell = dynamic_cast<MyCell*>(so)) {
       if (cell->GetDiameter() < 8) {
-        auto* random = Simulation::GetActive()->GetRandom();
-
         // Here 400 is the speed and the change to the volume is based on the
         // simulation time step.
         // The default here is 0.01 for timestep, not 1.
         cell->ChangeVolume(400);
-        
-        // Here below is a random seed link to the clock.
-        // The random result change with time.
-        // If you run this simulation for multiple times, you will get different results.
-        
-        random->SetSeed(((unsigned int)std::time(0))*t);
-        // create an array of 3 random numbers between -2 and 2
-        Double3 cell_movements{random->Uniform(-2, 2), random->Uniform(-2, 2), random->Uniform(-2, 2)};
-        // update the cell mass location, ie move the cell
-        cell->UpdatePosition(cell_movements);
+        cell->SetMigrates(true);
       } 
       else {
               cell->Divide();
            }
     }
-    // t is how many simulation timesteps passed.
-    // t in the SetSeed() means there will be a new seed for each timestep.
-        t++;
   }
-   private:
-  unsigned t = 0;
 };
 
-inline int Simulate(int argc, const char** argv) {
-  auto set_param = [](Param* param) {
+/// Result of RunCellDistribution
+struct CellDistributionResult {
+  /// seed of the random walk (the clock if the scenario has none)
+  uint64_t seed = 0;
+  /// number of cells at the start and after every timestep
+  std::vector<uint64_t> cells;
+  /// positions of the cells at the end (only with keep_positions)
+  std::vector<Double3> positions;
+  /// every shape_interval timesteps
+  std::vector<ShapeAnalysis::Result> shapes;
+  RunTimings timings;
+};
+
+/// Runs the scenario; `argc` and `argv` are passed to Simulation (name of
+/// the simulation, BioDynaMo options). The trajectory, histograms and
+/// shape.csv are written to the output directory as well.
+inline CellDistributionResult RunCellDistribution(
+    const CellDistributionScenario& scenario, int argc, const char** argv) {
+  Stopwatch total_time;
+  auto set_param = [&](Param* param) {
     param->bound_space_ = true;
-    param->min_bound_ = 0;
-    param->max_bound_ = 300;  // cube of 100*100*100
+    param->min_bound_ = scenario.min_bound;
+    param->max_bound_ = scenario.max_bound;  // cube of 300*300*300 by default
   };
 
   Simulation simulation(argc, argv, set_param);
   auto* rm = simulation.GetResourceManager();
+  auto* param = simulation.GetParam();
 
 
-  // create a cancerous cell, containing the biology module GrowthModule
-  MyCell* cell = new MyCell({150, 150, 150});
-  cell->SetDiameter(6);
+  // create a cancerous cell at the center of the simulation space,
+  // containing the biology module GrowthModule
+  double center = (scenario.min_bound + scenario.max_bound) / 2;
+  MyCell* cell = new MyCell({center, center, center});
+  cell->SetDiameter(scenario.initial_diameter);
   cell->AddBiologyModule(new GrowthModule());
   rm->push_back(cell);  // put the created cell in our cells structure
 
 
   // Run simulation
-  simulation.GetScheduler()->Simulate(500);
-  
+  // The positions of all cells are appended to the trajectory after every
+  // timestep (see TrajectoryReader to read them).
+  // Every histogram_interval timesteps the cell positions are reduced to a
+  // 3D histogram, per-axis marginals and a radial density profile, which are
+  // written to the output directory.
+  TrajectoryWriter trajectory(simulation.GetOutputDir() + "/trajectory");
+  DensityHistogram histogram(param->min_bound_, param->max_bound_,
+                             scenario.histogram_bins, scenario.radial_bins);
+  // The random walk is a function of the seed, the timestep and the uid of a
+  // cell, so a run can be repeated with --seed (the seed is printed below).
+  uint64_t seed = scenario.seed != 0
+                      ? scenario.seed
+                      : static_cast<unsigned int>(std::time(0));
+  MigrationStage migration(seed, scenario.migration_range, param->min_bound_,
+                           param->max_bound_);
+  // Every shape_interval timesteps the surface cells, surface area,
+  // sphericity and principal axes of the tumor are appended to shape.csv.
+  ShapeAnalysis shape(scenario.shape_radius, scenario.surface_neighbors);
+  const std::string shape_file = simulation.GetOutputDir() + "/shape.csv";
+  std::remove(shape_file.c_str());
+  LocalityMonitor locality(scenario.sort_check_interval,
+                           scenario.sort_threshold);
+  CellDistributionResult result;
+  result.seed = seed;
+  result.cells.push_back(rm->GetNumSimObjects());
+  result.timings.setup = total_time.Seconds();
+  for (uint64_t step = 1; step <= scenario.steps; step++) {
+    auto step_start = std::chrono::steady_clock::now();
+    simulation.GetScheduler()->Simulate(1);
+    // every growing cell moves up to migration_range along each axis
+    migration.Run(step, rm, [](SimObject* so) {
+      auto* cell = bdm_static_cast<MyCell*>(so);
+      bool migrates = cell->GetMigrates();
+      cell->SetMigrates(false);
+      return migrates;
+    });
+    std::chrono::duration<double> step_time =
+        std::chrono::steady_clock::now() - step_start;
+    result.cells.push_back(rm->GetNumSimObjects());
+    result.timings.steps.push_back(step_time.count());
+    // cells that are close in space are kept close in memory
+    if (locality.Update(step, rm, step_time.count()) && scenario.print) {
+      locality.GetReport().Print();
+    }
+    trajectory.Append(step, rm);
+    if (step % scenario.histogram_interval == 0) {
+      histogram.Compute(rm);
+      histogram.Write(simulation.GetOutputDir(), step);
+    }
+    if (scenario.shape_interval != 0 && step % scenario.shape_interval == 0) {
+      result.shapes.push_back(shape.Compute(step, &simulation));
+      shape.Append(shape_file);
+    }
+  }
+  if (scenario.keep_positions) {
+    result.positions = CollectPositions(rm);
+  }
+  result.timings.total = total_time.Seconds();
+  if (!scenario.print) {
+    return result;
+  }
+
   long unsigned int num_allcell;
   num_allcell = rm->GetNumSimObjects();
 
@@ -115,8 +270,35 @@ inline int Simulate(int argc, const char** argv) {
         std::cout << "Cell UID: "<< cell->GetUid()<< " Cell x coordinate: "<< cell->GetPosition()[0]<< std::endl;
   }
     
-  std::cout << "In this simulation, cells migrate ramdomly from (-2,-2,-2) to (2,2,2) every timestep" << std::endl;
-  std::cout << "number of cells after 500 timesteps: " << rm->GetNumSimObjects() << std::endl;
+  const double r = scenario.migration_range;
+  std::cout << "In this simulation, cells migrate ramdomly from (" << -r << "," << -r << "," << -r << ") to (" << r << "," << r << "," << r << ") every timestep" << std::endl;
+  if (scenario.shape_interval != 0) {
+    const auto& r = shape.GetResult();
+    std::cout << "shape after " << r.step << " timesteps: " << r.surface_cells
+              << " surface cells, sphericity " << r.sphericity
+              << ", semi-axes " << r.semi_axes[0] << ", " << r.semi_axes[1]
+              << ", " << r.semi_axes[2] << std::endl;
+  }
+  std::cout << "random seed: " << seed << std::endl;
+  std::cout << "number of cells after " << scenario.steps << " timesteps: " << rm->GetNumSimObjects() << std::endl;
+  return result;
+}
+
+/// Library entry point: runs the scenario without command line, e.g.
+///   CellDistributionScenario scenario;
+///   scenario.print = false;
+///   auto result = RunCellDistribution(scenario);
+inline CellDistributionResult RunCellDistribution(
+    const CellDistributionScenario& scenario) {
+  const char* argv[] = {"CellDistribution", nullptr};
+  return RunCellDistribution(scenario, 1, argv);
+}
+
+inline int Simulate(int argc, const char** argv) {
+  ScenarioOptions options(&argc, argv);
+  auto scenario = CellDistributionScenario::FromOptions(&options);
+  options.CheckAllUsed();
+  RunCellDistribution(scenario, argc, argv);
   return 0;
 }
 
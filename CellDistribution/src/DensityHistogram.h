@@ -0,0 +1,190 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#ifndef DENSITY_HISTOGRAM_H_
+#define DENSITY_HISTOGRAM_H_
+
+#include <omp.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "biodynamo.h"
+#include "cache_aligned.h"
+
+namespace bdm {
+
+// Reduces the cell positions to a few small arrays inside the simulation:
+//  - occupancy (cells per bin) and density (cells per volume) of a 3D grid
+//  - radial density profile around the centroid of the tumor
+//  - marginal histograms along the x, y and z axis
+// Every thread fills its own bins, which are merged afterwards. The cost of
+// writing the result depends on the number of bins, not on the number of
+// cells.
+class DensityHistogram {
+ public:
+  DensityHistogram(double min_bound, double max_bound, int bins_per_axis,
+                   int radial_bins)
+      : min_bound_(min_bound),
+        bins_(bins_per_axis),
+        radial_bins_(radial_bins) {
+    bin_length_ = (max_bound - min_bound) / bins_;
+    // the largest possible distance from the centroid is the space diagonal
+    radial_bin_length_ = (max_bound - min_bound) * std::sqrt(3.0) / radial_bins_;
+    occupancy_.resize(static_cast<size_t>(bins_) * bins_ * bins_);
+    marginals_.resize(3 * bins_);
+    radial_.resize(radial_bins_);
+  }
+
+  /// Bins the position of every simulation object.
+  void Compute(ResourceManager* rm) {
+    num_cells_ = rm->GetNumSimObjects();
+    const int num_threads = omp_get_max_threads();
+
+    // first pass: centroid (one cache line per thread)
+    CacheAlignedArray<Double3> thread_sum(num_threads, {0, 0, 0});
+    rm->ApplyOnAllElementsParallel([&](SimObject* so) {
+      auto& sum = thread_sum[omp_get_thread_num()];
+      const auto& pos = so->GetPosition();
+      sum[0] += pos[0];
+      sum[1] += pos[1];
+      sum[2] += pos[2];
+    });
+    centroid_ = {0, 0, 0};
+    for (int t = 0; t < num_threads; t++) {
+      for (int i = 0; i < 3; i++) {
+        centroid_[i] += thread_sum[t][i];
+      }
+    }
+    if (num_cells_ != 0) {
+      for (int i = 0; i < 3; i++) {
+        centroid_[i] /= num_cells_;
+      }
+    }
+
+    // second pass: thread-local bins
+    // layout: occupancy | marginals x, y, z | radial
+    const size_t num_3d = occupancy_.size();
+    const size_t stride = num_3d + marginals_.size() + radial_.size();
+    std::vector<uint64_t> thread_bins(num_threads * stride, 0);
+    rm->ApplyOnAllElementsParallel([&](SimObject* so) {
+      uint64_t* bins = &thread_bins[omp_get_thread_num() * stride];
+      const auto& pos = so->GetPosition();
+      int b[3];
+      for (int i = 0; i < 3; i++) {
+        b[i] = Bin(pos[i]);
+        bins[num_3d + i * bins_ + b[i]]++;
+      }
+      bins[Index(b[0], b[1], b[2])]++;
+      double dx = pos[0] - centroid_[0];
+      double dy = pos[1] - centroid_[1];
+      double dz = pos[2] - centroid_[2];
+      int r = static_cast<int>(std::sqrt(dx * dx + dy * dy + dz * dz) /
+                               radial_bin_length_);
+      bins[num_3d + marginals_.size() + std::min(r, radial_bins_ - 1)]++;
+    });
+
+    // merge
+#pragma omp parallel for
+    for (size_t i = 0; i < stride; i++) {
+      uint64_t sum = 0;
+      for (int t = 0; t < num_threads; t++) {
+        sum += thread_bins[t * stride + i];
+      }
+      if (i < num_3d) {
+        occupancy_[i] = sum;
+      } else if (i < num_3d + marginals_.size()) {
+        marginals_[i - num_3d] = sum;
+      } else {
+        radial_[i - num_3d - marginals_.size()] = sum;
+      }
+    }
+  }
+
+  /// Writes the arrays of the last Compute() call as csv files into `dir`.
+  void Write(const std::string& dir, uint64_t step) const {
+    const std::string suffix = "-" + std::to_string(step) + ".csv";
+    const double bin_volume = bin_length_ * bin_length_ * bin_length_;
+
+    // only non-empty bins are written
+    std::ofstream grid(dir + "/histogram3d" + suffix);
+    grid << "ix,iy,iz,count,density\n";
+    for (int z = 0; z < bins_; z++) {
+      for (int y = 0; y < bins_; y++) {
+        for (int x = 0; x < bins_; x++) {
+          uint64_t count = occupancy_[Index(x, y, z)];
+          if (count != 0) {
+            grid << x << "," << y << "," << z << "," << count << ","
+                 << count / bin_volume << "\n";
+          }
+        }
+      }
+    }
+
+    std::ofstream marginals(dir + "/marginals" + suffix);
+    marginals << "bin_start,x,y,z\n";
+    for (int b = 0; b < bins_; b++) {
+      marginals << min_bound_ + b * bin_length_ << "," << marginals_[b] << ","
+                << marginals_[bins_ + b] << "," << marginals_[2 * bins_ + b]
+                << "\n";
+    }
+
+    std::ofstream radial(dir + "/radial" + suffix);
+    radial << "# centroid " << centroid_[0] << " " << centroid_[1] << " "
+           << centroid_[2] << "\n";
+    radial << "r_inner,r_outer,count,density\n";
+    for (int b = 0; b < radial_bins_; b++) {
+      double r_inner = b * radial_bin_length_;
+      double r_outer = r_inner + radial_bin_length_;
+      double shell_volume =
+          4.0 / 3.0 * M_PI *
+          (r_outer * r_outer * r_outer - r_inner * r_inner * r_inner);
+      radial << r_inner << "," << r_outer << "," << radial_[b] << ","
+             << radial_[b] / shell_volume << "\n";
+    }
+  }
+
+  const Double3& GetCentroid() const { return centroid_; }
+  const std::vector<uint64_t>& GetOccupancy() const { return occupancy_; }
+  const std::vector<uint64_t>& GetRadialProfile() const { return radial_; }
+  /// x, y and z marginals, one after another
+  const std::vector<uint64_t>& GetMarginals() const { return marginals_; }
+
+ private:
+  double min_bound_;
+  int bins_;
+  int radial_bins_;
+  double bin_length_;
+  double radial_bin_length_;
+  uint64_t num_cells_ = 0;
+  Double3 centroid_ = {0, 0, 0};
+  std::vector<uint64_t> occupancy_;
+  std::vector<uint64_t> marginals_;
+  std::vector<uint64_t> radial_;
+
+  int Bin(double pos) const {
+    int b = static_cast<int>(std::floor((pos - min_bound_) / bin_length_));
+    return std::min(std::max(b, 0), bins_ - 1);
+  }
+
+  size_t Index(int x, int y, int z) const {
+    return (static_cast<size_t>(z) * bins_ + y) * bins_ + x;
+  }
+};
+
+}  // namespace bdm
+
+#endif  // DENSITY_HISTOGRAM_H_
@@ -0,0 +1,272 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#ifndef SHAPE_ANALYSIS_H_
+#define SHAPE_ANALYSIS_H_
+
+#include <omp.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "biodynamo.h"
+#include "cache_aligned.h"
+
+namespace bdm {
+
+// Shape of the tumor, measured inside the simulation.
+//
+//  - surface cells: cells with less than `surface_neighbors` neighbors
+//    within `radius`, found with the neighbor grid of the simulation
+//  - surface area: the surface cells are assumed to form one layer, each
+//    covering the cross section of a cell (pi d^2 / 4, hexagonally packed)
+//  - volume: sum of the cell volumes
+//  - sphericity: surface area of a sphere with the same volume divided by
+//    the surface area (1 for a ball, smaller for irregular shapes)
+//  - principal axes: eigenvectors of the covariance of the cell positions;
+//    the semi-axes are sqrt(5 * eigenvalue), the semi-axes of a solid
+//    ellipsoid with the same covariance
+// Area and volume are estimates; they are meant to compare timesteps and
+// runs, not to give absolute values.
+//
+// The neighbor grid only searches the boxes next to the box of a cell, and
+// the box length is the largest cell diameter, so the radius is limited to
+// the box length (larger radii are clamped with a warning).
+//
+// Every thread accumulates its own sums, which are merged afterwards.
+class ShapeAnalysis {
+ public:
+  struct Result {
+    uint64_t step = 0;
+    uint64_t cells = 0;
+    uint64_t surface_cells = 0;
+    double volume = 0;
+    double surface_area = 0;
+    double sphericity = 0;
+    Double3 centroid = {0, 0, 0};
+    /// semi-axes, longest first
+    Double3 semi_axes = {0, 0, 0};
+    /// unit vectors of the principal axes, in the order of semi_axes
+    Double3 axes[3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+  };
+
+  ShapeAnalysis(double radius, int surface_neighbors)
+      : radius_(radius), surface_neighbors_(surface_neighbors) {}
+
+  /// Analyses the current positions of all simulation objects
+  const Result& Compute(uint64_t step, Simulation* simulation) {
+    auto* rm = simulation->GetResourceManager();
+    auto* grid = simulation->GetGrid();
+    // daughters and moved cells of the last timestep
+    grid->UpdateGrid();
+    double radius = radius_;
+    if (radius > grid->GetBoxLength()) {
+      radius = grid->GetBoxLength();
+      if (!clamped_) {
+        Log::Warning("ShapeAnalysis", "shape_radius ", radius_,
+                     " is larger than the box length of the neighbor grid, ",
+                     radius, " is used instead");
+        clamped_ = true;
+      }
+    }
+    const double squared_radius = radius * radius;
+
+    // per thread: cells, surface cells, volume, surface area,
+    //             sum x, y, z, sum xx, xy, xz, yy, yz, zz
+    CacheAlignedArray<Sums> thread_sums(omp_get_max_threads(), Sums{});
+    rm->ApplyOnAllElementsParallel([&](SimObject* so) {
+      auto& sums = thread_sums[omp_get_thread_num()];
+      int neighbors = 0;
+      grid->ForEachNeighborWithinRadius(
+          [&](const SimObject* neighbor) {
+            if (neighbor != so) {
+              neighbors++;
+            }
+          },
+          *so, squared_radius);
+      const double d = so->GetDiameter();
+      sums[0] += 1;
+      sums[2] += Math::kPi / 6 * d * d * d;
+      if (neighbors < surface_neighbors_) {
+        sums[1] += 1;
+        sums[3] += Math::kPi / 4 * d * d / kHexagonalPacking;
+      }
+      const auto& pos = so->GetPosition();
+      for (int i = 0; i < 3; i++) {
+        sums[4 + i] += pos[i];
+      }
+      sums[7] += pos[0] * pos[0];
+      sums[8] += pos[0] * pos[1];
+      sums[9] += pos[0] * pos[2];
+      sums[10] += pos[1] * pos[1];
+      sums[11] += pos[1] * pos[2];
+      sums[12] += pos[2] * pos[2];
+    });
+    Sums sums{};
+    for (size_t t = 0; t < thread_sums.size(); t++) {
+      for (size_t i = 0; i < sums.size(); i++) {
+        sums[i] += thread_sums[t][i];
+      }
+    }
+
+    result_ = Result();
+    result_.step = step;
+    result_.cells = static_cast<uint64_t>(sums[0]);
+    result_.surface_cells = static_cast<uint64_t>(sums[1]);
+    result_.volume = sums[2];
+    result_.surface_area = sums[3];
+    if (result_.cells == 0) {
+      return result_;
+    }
+    if (result_.surface_area != 0) {
+      result_.sphericity = std::cbrt(Math::kPi) *
+                           std::pow(6 * result_.volume, 2.0 / 3.0) /
+                           result_.surface_area;
+    }
+
+    const double n = sums[0];
+    auto& c = result_.centroid;
+    c = {sums[4] / n, sums[5] / n, sums[6] / n};
+    double covariance[3][3];
+    covariance[0][0] = sums[7] / n - c[0] * c[0];
+    covariance[0][1] = sums[8] / n - c[0] * c[1];
+    covariance[0][2] = sums[9] / n - c[0] * c[2];
+    covariance[1][1] = sums[10] / n - c[1] * c[1];
+    covariance[1][2] = sums[11] / n - c[1] * c[2];
+    covariance[2][2] = sums[12] / n - c[2] * c[2];
+    covariance[1][0] = covariance[0][1];
+    covariance[2][0] = covariance[0][2];
+    covariance[2][1] = covariance[1][2];
+    double eigenvalues[3];
+    double eigenvectors[3][3];
+    Jacobi(covariance, eigenvalues, eigenvectors);
+
+    // longest axis first
+    int order[3] = {0, 1, 2};
+    std::sort(order, order + 3, [&](int a, int b) {
+      return eigenvalues[a] > eigenvalues[b];
+    });
+    for (int i = 0; i < 3; i++) {
+      int k = order[i];
+      result_.semi_axes[i] = std::sqrt(5 * std::max(eigenvalues[k], 0.0));
+      result_.axes[i] = {eigenvectors[0][k], eigenvectors[1][k],
+                         eigenvectors[2][k]};
+    }
+    return result_;
+  }
+
+  const Result& GetResult() const { return result_; }
+
+  /// Appends the last result to the csv file `filename`; the header is
+  /// written if the file is new
+  void Append(const std::string& filename) const {
+    bool exists = std::ifstream(filename).good();
+    std::ofstream ofs(filename, std::ios::app);
+    if (!exists) {
+      ofs << "step,cells,surface_cells,volume,surface_area,sphericity,"
+             "centroid_x,centroid_y,centroid_z,a1,a2,a3,"
+             "axis1_x,axis1_y,axis1_z,axis2_x,axis2_y,axis2_z,"
+             "axis3_x,axis3_y,axis3_z\n";
+    }
+    const auto& r = result_;
+    ofs << r.step << "," << r.cells << "," << r.surface_cells << ","
+        << r.volume << "," << r.surface_area << "," << r.sphericity;
+    for (int i = 0; i < 3; i++) {
+      ofs << "," << r.centroid[i];
+    }
+    for (int i = 0; i < 3; i++) {
+      ofs << "," << r.semi_axes[i];
+    }
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) {
+        ofs << "," << r.axes[i][j];
+      }
+    }
+    ofs << "\n";
+  }
+
+  /// Eigenvalues and eigenvectors (columns of `vectors`) of the symmetric
+  /// 3x3 matrix `a`, with cyclic Jacobi rotations
+  static void Jacobi(const double a[3][3], double values[3],
+                     double vectors[3][3]) {
+    double m[3][3];
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) {
+        m[i][j] = a[i][j];
+        vectors[i][j] = i == j ? 1 : 0;
+      }
+    }
+    for (int sweep = 0; sweep < 50; sweep++) {
+      double off = m[0][1] * m[0][1] + m[0][2] * m[0][2] + m[1][2] * m[1][2];
+      double diagonal = m[0][0] * m[0][0] + m[1][1] * m[1][1] + m[2][2] * m[2][2];
+      if (off <= 1e-30 * diagonal || off == 0) {
+        break;
+      }
+      for (int p = 0; p < 2; p++) {
+        for (int q = p + 1; q < 3; q++) {
+          if (m[p][q] == 0) {
+            continue;
+          }
+          // rotation that zeroes m[p][q]
+          double theta = (m[q][q] - m[p][p]) / (2 * m[p][q]);
+          double t = (theta >= 0 ? 1 : -1) /
+                     (std::abs(theta) + std::sqrt(theta * theta + 1));
+          double cos = 1 / std::sqrt(t * t + 1);
+          double sin = t * cos;
+          for (int k = 0; k < 3; k++) {
+            double mkp = m[k][p];
+            double mkq = m[k][q];
+            m[k][p] = cos * mkp - sin * mkq;
+            m[k][q] = sin * mkp + cos * mkq;
+          }
+          for (int k = 0; k < 3; k++) {
+            double mpk = m[p][k];
+            double mqk = m[q][k];
+            m[p][k] = cos * mpk - sin * mqk;
+            m[q][k] = sin * mpk + cos * mqk;
+          }
+          for (int k = 0; k < 3; k++) {
+            double vkp = vectors[k][p];
+            double vkq = vectors[k][q];
+            vectors[k][p] = cos * vkp - sin * vkq;
+            vectors[k][q] = sin * vkp + cos * vkq;
+          }
+        }
+      }
+    }
+    for (int i = 0; i < 3; i++) {
+      values[i] = m[i][i];
+    }
+  }
+
+ private:
+  /// fraction of a plane covered by hexagonally packed disks
+  static constexpr double kHexagonalPacking = 0.9069;
+
+  using Sums = std::array<double, 13>;
+
+  double radius_;
+  int surface_neighbors_;
+  /// true once the radius was clamped to the box length (warned once)
+  bool clamped_ = false;
+  Result result_;
+};
+
+}  // namespace bdm
+
+#endif  // SHAPE_ANALYSIS_H_
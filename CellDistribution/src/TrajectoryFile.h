@@ -0,0 +1,266 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#ifndef TRAJECTORY_FILE_H_
+#define TRAJECTORY_FILE_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "biodynamo.h"
+
+namespace bdm {
+
+// Trajectory of all cells, one block per timestep.
+//
+// <name>.traj   header, then one block per recorded timestep:
+//                 uint64_t step, uint64_t num_cells,
+//                 uint64_t uid[num_cells]    (sorted)
+//                 float    xyz[3 * num_cells]
+//                 padding to a multiple of 8 bytes
+// <name>.idx    one entry per block: uint64_t step, uint64_t offset
+//
+// Both files are only appended to. TrajectoryReader maps them into memory,
+// so it can jump to any timestep, or to the track of one cell, without
+// parsing the whole file.
+struct TrajectoryFormat {
+  static const char* Magic() { return "BDMTRAJ1"; }
+  static constexpr size_t kHeaderSize = 8;
+
+  struct IndexEntry {
+    uint64_t step;
+    uint64_t offset;
+  };
+
+  struct BlockHeader {
+    uint64_t step;
+    uint64_t num_cells;
+  };
+
+  static size_t BlockSize(uint64_t num_cells) {
+    size_t size = sizeof(BlockHeader) + num_cells * sizeof(uint64_t) +
+                  3 * num_cells * sizeof(float);
+    return (size + 7) / 8 * 8;
+  }
+};
+
+class TrajectoryWriter {
+ public:
+  /// Creates (or truncates) <name>.traj and <name>.idx
+  explicit TrajectoryWriter(const std::string& name) {
+    data_ = fopen((name + ".traj").c_str(), "wb");
+    index_ = fopen((name + ".idx").c_str(), "wb");
+    if (data_ == nullptr || index_ == nullptr) {
+      Log::Fatal("TrajectoryWriter", "Could not create trajectory ", name);
+    }
+    fwrite(TrajectoryFormat::Magic(), 1, TrajectoryFormat::kHeaderSize, data_);
+    offset_ = TrajectoryFormat::kHeaderSize;
+  }
+
+  ~TrajectoryWriter() {
+    fclose(data_);
+    fclose(index_);
+  }
+
+  TrajectoryWriter(const TrajectoryWriter&) = delete;
+  TrajectoryWriter& operator=(const TrajectoryWriter&) = delete;
+
+  /// Appends the positions of all simulation objects as block `step`.
+  void Append(uint64_t step, ResourceManager* rm) {
+    cells_.clear();
+    rm->ApplyOnAllElements([&](SimObject* so) {
+      cells_.push_back({static_cast<uint64_t>(so->GetUid()), so});
+    });
+    std::sort(cells_.begin(), cells_.end(),
+              [](const std::pair<uint64_t, SimObject*>& a,
+                 const std::pair<uint64_t, SimObject*>& b) {
+                return a.first < b.first;
+              });
+
+    const uint64_t n = cells_.size();
+    uids_.resize(n);
+    positions_.resize(3 * n);
+    for (uint64_t i = 0; i < n; i++) {
+      uids_[i] = cells_[i].first;
+      const auto& pos = cells_[i].second->GetPosition();
+      positions_[3 * i] = static_cast<float>(pos[0]);
+      positions_[3 * i + 1] = static_cast<float>(pos[1]);
+      positions_[3 * i + 2] = static_cast<float>(pos[2]);
+    }
+
+    TrajectoryFormat::BlockHeader header{step, n};
+    fwrite(&header, sizeof(header), 1, data_);
+    fwrite(uids_.data(), sizeof(uint64_t), n, data_);
+    fwrite(positions_.data(), sizeof(float), 3 * n, data_);
+    size_t block_size = TrajectoryFormat::BlockSize(n);
+    size_t written = sizeof(header) + n * sizeof(uint64_t) + 3 * n * sizeof(float);
+    static const char kPadding[8] = {0};
+    fwrite(kPadding, 1, block_size - written, data_);
+
+    TrajectoryFormat::IndexEntry entry{step, offset_};
+    fwrite(&entry, sizeof(entry), 1, index_);
+    offset_ += block_size;
+    // a reader must never see an index entry without its block
+    fflush(data_);
+    fflush(index_);
+  }
+
+ private:
+  FILE* data_;
+  FILE* index_;
+  uint64_t offset_;
+  std::vector<std::pair<uint64_t, SimObject*>> cells_;
+  std::vector<uint64_t> uids_;
+  std::vector<float> positions_;
+};
+
+class TrajectoryReader {
+ public:
+  /// Cells of one timestep. uids are sorted, position of uids[i] is
+  /// positions[3 * i], positions[3 * i + 1], positions[3 * i + 2].
+  struct Step {
+    uint64_t step;
+    uint64_t num_cells;
+    const uint64_t* uids;
+    const float* positions;
+  };
+
+  struct TrackPoint {
+    uint64_t step;
+    float x;
+    float y;
+    float z;
+  };
+
+  /// Maps <name>.traj and <name>.idx into memory
+  explicit TrajectoryReader(const std::string& name) {
+    data_ = Map(name + ".traj", &data_size_);
+    index_ = Map(name + ".idx", &index_size_);
+    if (data_size_ < TrajectoryFormat::kHeaderSize ||
+        memcmp(data_, TrajectoryFormat::Magic(),
+               TrajectoryFormat::kHeaderSize) != 0) {
+      Log::Fatal("TrajectoryReader", name, ".traj is not a trajectory file");
+    }
+    num_steps_ = index_size_ / sizeof(TrajectoryFormat::IndexEntry);
+  }
+
+  ~TrajectoryReader() {
+    Unmap(data_, data_size_);
+    Unmap(index_, index_size_);
+  }
+
+  TrajectoryReader(const TrajectoryReader&) = delete;
+  TrajectoryReader& operator=(const TrajectoryReader&) = delete;
+
+  /// Number of recorded timesteps
+  size_t GetNumSteps() const { return num_steps_; }
+
+  /// Returns the i-th recorded block, or a Step without cells if
+  /// i >= GetNumSteps() (e.g. FindStep() did not find the timestep)
+  Step GetStep(size_t i) const {
+    if (i >= num_steps_) {
+      return {0, 0, nullptr, nullptr};
+    }
+    auto* entry =
+        reinterpret_cast<const TrajectoryFormat::IndexEntry*>(index_) + i;
+    if (entry->offset > data_size_ ||
+        data_size_ - entry->offset < sizeof(TrajectoryFormat::BlockHeader)) {
+      Log::Fatal("TrajectoryReader", "Block ", i, " is outside of the file");
+    }
+    auto* header = reinterpret_cast<const TrajectoryFormat::BlockHeader*>(
+        data_ + entry->offset);
+    if (data_size_ - entry->offset <
+        TrajectoryFormat::BlockSize(header->num_cells)) {
+      Log::Fatal("TrajectoryReader", "Block ", i, " is truncated");
+    }
+    auto* uids = reinterpret_cast<const uint64_t*>(header + 1);
+    auto* positions = reinterpret_cast<const float*>(uids + header->num_cells);
+    return {header->step, header->num_cells, uids, positions};
+  }
+
+  /// Returns the index of the block of timestep `step`, or GetNumSteps() if
+  /// the timestep was not recorded.
+  size_t FindStep(uint64_t step) const {
+    auto* begin = reinterpret_cast<const TrajectoryFormat::IndexEntry*>(index_);
+    auto* end = begin + num_steps_;
+    auto* it = std::lower_bound(
+        begin, end, step,
+        [](const TrajectoryFormat::IndexEntry& e, uint64_t s) {
+          return e.step < s;
+        });
+    return it != end && it->step == step ? it - begin : num_steps_;
+  }
+
+  /// Positions of cell `uid` in all blocks in which it exists
+  std::vector<TrackPoint> GetTrack(uint64_t uid) const {
+    std::vector<TrackPoint> track;
+    for (size_t i = 0; i < num_steps_; i++) {
+      Step step = GetStep(i);
+      auto* it = std::lower_bound(step.uids, step.uids + step.num_cells, uid);
+      if (it != step.uids + step.num_cells && *it == uid) {
+        const float* pos = step.positions + 3 * (it - step.uids);
+        track.push_back({step.step, pos[0], pos[1], pos[2]});
+      }
+    }
+    return track;
+  }
+
+ private:
+  const char* data_;
+  const char* index_;
+  size_t data_size_;
+  size_t index_size_;
+  size_t num_steps_;
+
+  static const char* Map(const std::string& file, size_t* size) {
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd == -1) {
+      Log::Fatal("TrajectoryReader", "Could not open ", file);
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+      close(fd);
+      Log::Fatal("TrajectoryReader", "Could not open ", file);
+    }
+    *size = st.st_size;
+    void* ptr = nullptr;
+    if (*size != 0) {
+      ptr = mmap(nullptr, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // the mapping stays valid without the file descriptor
+    close(fd);
+    if (ptr == MAP_FAILED) {
+      Log::Fatal("TrajectoryReader", "Could not map ", file);
+    }
+    return static_cast<const char*>(ptr);
+  }
+
+  static void Unmap(const char* ptr, size_t size) {
+    if (ptr != nullptr) {
+      munmap(const_cast<char*>(ptr), size);
+    }
+  }
+};
+
+}  // namespace bdm
+
+#endif  // TRAJECTORY_FILE_H_
@@ -13,4 +13,17 @@
 // -----------------------------------------------------------------------------
 #include "CellNumber.h"
 
-int main(int argc, const char** argv) { return bdm::Simulate(argc, argv); }
+#ifdef USE_MPI
+#include <mpi.h>
+#endif  // USE_MPI
+
+int main(int argc, const char** argv) {
+#ifdef USE_MPI
+  MPI_Init(nullptr, nullptr);
+  int ret = bdm::Simulate(argc, argv);
+  MPI_Finalize();
+  return ret;
+#else
+  return bdm::Simulate(argc, argv);
+#endif  // USE_MPI
+}
@@ -15,7 +15,16 @@
 #define CELLNUMBER_H_
 
 #include "biodynamo.h"
+#include <chrono>
 #include <ctime>
+#include "Checkpoint.h"
+#include "DomainDecomposition.h"
+#include "command_line.h"
+#include "locality.h"
+#include "run_result.h"
+#include "scenario_options.h"
+#include "stop_conditions.h"
+#include "trace.h"
 
 namespace bdm {
 
@@ -58,20 +67,93 @@ class MyCell : public Cell {  // our object extends the Cell object
   bool can_divide_;
 };
 
+/// Parameters of the simulation, read from the [scenario] section of
+/// bdm.toml or from the command line (e.g. --division_probability=0.8)
+struct CellNumberScenario {
+  uint64_t steps = 500;
+  /// the number of cells is printed every report_interval timesteps
+  uint64_t report_interval = 10;
+  /// probability that a cell which reached its full size divides
+  double division_probability = 0.9;
+  double initial_diameter = 6.35;
+  /// simulation space is the cube [min_bound, max_bound]^3
+  double min_bound = 0;
+  double max_bound = 300;
+  /// 0 disables checkpoints
+  uint64_t checkpoint_interval = 50;
+  /// 0: use the clock, i.e. different results for every run
+  uint64_t seed = 0;
+  /// end the simulation early, e.g. when the population stopped growing
+  StopConditions stop;
+  /// every sort_check_interval timesteps the cells are reordered in memory
+  /// if their locality got sort_threshold times worse (see LocalityMonitor);
+  /// 0 disables the reordering
+  uint64_t sort_check_interval = 10;
+  double sort_threshold = 2;
+  /// continue from the last checkpoint in the output directory (--resume)
+  bool resume = false;
+  /// false: nothing is written to stdout, only the CellNumberResult is
+  /// returned (e.g. for drivers that run many scenarios in one process)
+  bool print = true;
+  /// true: the CellNumberResult contains the final cell positions (off by
+  /// default, sweeps only need the numbers of cells)
+  bool keep_positions = false;
+
+  /// Reads and validates all parameters
+  static CellNumberScenario FromOptions(ScenarioOptions* options) {
+    CellNumberScenario scenario;
+    scenario.steps = options->GetInt("steps", scenario.steps, 1, 1e7);
+    scenario.report_interval = options->GetInt(
+        "report_interval", scenario.report_interval, 1, scenario.steps);
+    scenario.division_probability = options->GetDouble(
+        "division_probability", scenario.division_probability, 0, 1);
+    scenario.initial_diameter = options->GetDouble(
+        "initial_diameter", scenario.initial_diameter, 0.1, 8);
+    scenario.min_bound =
+        options->GetDouble("min_bound", scenario.min_bound, -1e6, 1e6);
+    scenario.max_bound =
+        options->GetDouble("max_bound", scenario.max_bound, -1e6, 1e6);
+    if (scenario.min_bound >= scenario.max_bound) {
+      Log::Fatal("CellNumberScenario",
+                 "min_bound must be smaller than max_bound");
+    }
+    scenario.checkpoint_interval = options->GetInt(
+        "checkpoint_interval", scenario.checkpoint_interval, 0, 1e7);
+    scenario.seed = options->GetInt("seed", scenario.seed, 0, INT64_MAX);
+    scenario.stop = StopConditions::FromOptions(options);
+    scenario.sort_check_interval = options->GetInt(
+        "sort_check_interval", scenario.sort_check_interval, 0, 1e7);
+    scenario.sort_threshold =
+        options->GetDouble("sort_threshold", scenario.sort_threshold, 1, 1e6);
+    return scenario;
+  }
+};
+
 // Define growth behaviour
 struct GrowthModule : public BaseBiologyModule {
   BDM_STATELESS_BM_HEADER(GrowthModule, BaseBiologyModule, 1);
 
   GrowthModule() : BaseBiologyModule(gAllEventIds) {}
+  GrowthModule(uint64_t seed, double division_probability) : GrowthModule() {
+    seed_ = seed;
+    division_probability_ = division_probability;
+  }
 
-  /// Empty default event constructor, because GrowthModule does not have state.
+  /// The daughter uses the same seed and division probability, but starts
+  /// counting timesteps again.
   template <typename TEvent, typename TBm>
   GrowthModule(const TEvent& event, TBm* other, uint64_t new_oid = 0)
-      : BaseBiologyModule(event, other, new_oid) {}
+      : BaseBiologyModule(event, other, new_oid) {
+    if (auto* mother = dynamic_cast<GrowthModule*>(other)) {
+      seed_ = mother->seed_;
+      division_probability_ = mother->division_probability_;
+    }
+  }
 
   /// event handler not needed, because Chemotaxis does not have state.
 
   void Run(SimObject* so) override {
+    TraceExtend trace("GrowthModule");
     if (auto* cell = dynamic_cast<MyCell*>(so)) {
       if (cell->GetDiameter() < 8) {
         // Here 400 is the speed and the change to the volume is based on the
@@ -80,16 +162,24 @@ struct GrowthModule : public BaseBiologyModule {
         cell->ChangeVolume(400);
 
       } else {
-        // Here below is a random seed link to the clock.
+        // Here below is a random seed link to the clock (seed_ is the time
+        // at which the simulation started).
         // The random result change with time.
         // If you run this simulation for multiple times, you will get different results.
         auto* random = Simulation::GetActive()->GetRandom();
-        random->SetSeed(((unsigned int)std::time(0))*t);
+        random->SetSeed(seed_*t);
 
-        if (cell->GetCanDivide() && random->Uniform(0, 1) > 0.1) {
+        if (cell->GetCanDivide() &&
+            random->Uniform(0, 1) > 1 - division_probability_) {
           cell->Divide();
         } else {
           cell->SetCanDivide(false);  // this cell won't divide anymore
+          // A quiescent cell has nothing left to do: without its biology
+          // module it is skipped by the biology module loop, but it is still
+          // pushed by the mechanics and exported. This module is deleted
+          // here, so it must not be accessed afterwards.
+          cell->RemoveBiologyModule(this);
+          return;
         }
       }
     }
@@ -98,40 +188,267 @@ struct GrowthModule : public BaseBiologyModule {
 
                 t++;
   }
+
+  // getter and setter for the timestep counter (used by checkpoints)
+  unsigned GetTimesteps() const { return t; }
+  void SetTimesteps(unsigned timesteps) { t = timesteps; }
+
        private:
   unsigned t = 1;
+  uint64_t seed_ = 0;
+  double division_probability_ = 0.9;
 };
 
-inline int Simulate(int argc, const char** argv) {
-  auto set_param = [](Param* param) {
+/// Result of RunCellNumber. In the distributed mode (USE_MPI) the cells and
+/// positions are those of this rank.
+struct CellNumberResult {
+  /// why the simulation ended
+  StopReason stop_reason = StopReason::kCompleted;
+  /// seed of the GrowthModules (the clock if the scenario has none)
+  uint64_t seed = 0;
+  /// timestep of the first entry of cells (of the checkpoint if resumed)
+  uint64_t first_step = 0;
+  /// number of cells at first_step and after every timestep
+  std::vector<uint64_t> cells;
+  /// positions of the cells at the end (only with keep_positions)
+  std::vector<Double3> positions;
+  RunTimings timings;
+};
+
+/// Runs the scenario; `argc` and `argv` are passed to Simulation (name of
+/// the simulation, BioDynaMo options).
+inline CellNumberResult RunCellNumber(const CellNumberScenario& scenario,
+                                      int argc, const char** argv) {
+  Stopwatch total_time;
+  auto set_param = [&](Param* param) {
     param->bound_space_ = true;
-    param->min_bound_ = 0;
-    param->max_bound_ = 300;  // cube of 300*300*300
+    param->min_bound_ = scenario.min_bound;
+    param->max_bound_ = scenario.max_bound;  // cube of 300*300*300 by default
+#ifdef USE_MPI
+    // every rank writes its visualization files into its own directory
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    param->output_dir_ += "/rank" + std::to_string(rank);
+#endif  // USE_MPI
   };
 
   Simulation simulation(argc, argv, set_param);
   auto* rm = simulation.GetResourceManager();
+  auto* param = simulation.GetParam();
+  uint64_t seed = scenario.seed != 0
+                      ? scenario.seed
+                      : static_cast<unsigned int>(std::time(0));
 
+  // A checkpoint stores everything needed to recreate a cell, and the same
+  // record is sent with a cell that moves to another rank
+  auto capture_cell = [](SimObject* so) {
+    auto* cell = bdm_static_cast<MyCell*>(so);
+    CellRecord record = {};
+    record.uid = static_cast<uint64_t>(cell->GetUid());
+    for (int i = 0; i < 3; i++) {
+      record.position[i] = cell->GetPosition()[i];
+      record.tractor_force[i] = cell->GetTractorForce()[i];
+      record.x_axis[i] = cell->GetXAxis()[i];
+      record.y_axis[i] = cell->GetYAxis()[i];
+      record.z_axis[i] = cell->GetZAxis()[i];
+    }
+    record.diameter = cell->GetDiameter();
+    record.volume = cell->GetVolume();
+    record.adherence = cell->GetAdherence();
+    record.density = cell->GetDensity();
+    record.can_divide = cell->GetCanDivide();
+    for (auto* bm : cell->GetAllBiologyModules()) {
+      if (auto* growth = dynamic_cast<GrowthModule*>(bm)) {
+        record.has_growth_module = true;
+        record.growth_timesteps = growth->GetTimesteps();
+      }
+    }
+    return record;
+  };
+  // Recreates a cell with the exact state it had. Ghost cells (copies of
+  // the cells of another rank) get no GrowthModule.
+  auto restore_cell = [&](const CellRecord& record, bool ghost) -> SimObject* {
+    auto to_double3 = [](const double* v) { return Double3{v[0], v[1], v[2]}; };
+    MyCell* cell = new MyCell(to_double3(record.position));
+    // The diameter follows from the volume (ChangeVolume, Divide), except
+    // for cells whose diameter was set directly, and the volume from it.
+    // Either way the same computation as in the original run restores both.
+    cell->SetVolume(record.volume);
+    if (cell->GetDiameter() != record.diameter) {
+      cell->SetDiameter(record.diameter);
+    }
+    if (cell->GetVolume() != record.volume) {
+      Log::Warning("Simulate", "Cell ", record.uid,
+                   " could not be restored exactly");
+    }
+    cell->SetTractorForce(to_double3(record.tractor_force));
+    cell->SetAdherence(record.adherence);
+    cell->SetDensity(record.density);
+    cell->SetXAxis(to_double3(record.x_axis));
+    cell->SetYAxis(to_double3(record.y_axis));
+    cell->SetZAxis(to_double3(record.z_axis));
+    cell->SetCanDivide(record.can_divide);
+    if (record.has_growth_module && !ghost) {
+      auto* growth = new GrowthModule(seed, scenario.division_probability);
+      growth->SetTimesteps(record.growth_timesteps);
+      cell->AddBiologyModule(growth);
+    }
+    return cell;
+  };
+  Checkpointer checkpointer(simulation.GetOutputDir(), capture_cell);
 
-  // create a cancerous cell, containing the biology module GrowthModule
-  // cell diameter starts at 6.35 and cell division happen when diameter reach 8
-  // Because the two spheres with a diameter of 6.35 are the same size as a sphere with a diameter of 8.
-  MyCell* cell = new MyCell({150, 150, 150});
-  cell->SetDiameter(6.35);
-  cell->SetCanDivide(true);
-  cell->AddBiologyModule(new GrowthModule());
-  rm->push_back(cell);  // put the created cell in our cells structure
+  // In the distributed mode (USE_MPI) every rank simulates a slab of the
+  // simulation space. Cells received from other ranks are restored from
+  // their records.
+  DomainDecomposition domain(param->min_bound_, param->max_bound_,
+                             capture_cell, restore_cell);
+
+  uint64_t step = 0;
+  double sort_baseline = 0;
+  std::vector<CellRecord> records;
+  if (scenario.resume &&
+      Checkpointer::Read(simulation.GetOutputDir(), &step, &seed,
+                         &sort_baseline, &records)) {
+    // cells are recreated in their order in memory, with the exact state
+    // they had, so the run continues as if it had not been interrupted
+    for (auto& record : records) {
+      rm->push_back(restore_cell(record, false));
+    }
+    // restored cells have new uids
+    checkpointer.Rebase();
+    if (scenario.print && domain.GetRank() == 0) {
+      std::cout << "Resumed from the checkpoint after " << step
+                << " timesteps" << std::endl;
+    }
+  } else {
+    if (scenario.resume) {
+      Log::Warning("Simulate", "No checkpoint in ", simulation.GetOutputDir(),
+                   ", starting a new simulation");
+    }
+    // create a cancerous cell, containing the biology module GrowthModule
+    // cell diameter starts at 6.35 and cell division happen when diameter reach 8
+    // Because the two spheres with a diameter of 6.35 are the same size as a sphere with a diameter of 8.
+    // The first cell is placed at the center of the simulation space.
+    double center = (scenario.min_bound + scenario.max_bound) / 2;
+    if (domain.Owns({center, center, center})) {
+      MyCell* cell = new MyCell({center, center, center});
+      cell->SetDiameter(scenario.initial_diameter);
+      cell->SetCanDivide(true);
+      cell->AddBiologyModule(
+          new GrowthModule(seed, scenario.division_probability));
+      rm->push_back(cell);
+    }
+  }
 
   // Run simulation
+  // Ghost cells are only present during a timestep, cells which left the
+  // slab of this rank are handed over after every timestep.
+  // All ranks stop together as soon as a stop condition holds on one rank.
+  auto* scheduler = simulation.GetScheduler();
+  StopMonitor stop(scenario.stop);
+  StopReason reason = StopReason::kCompleted;
+  LocalityMonitor locality(scenario.sort_check_interval,
+                           scenario.sort_threshold);
+  locality.SetBaseline(sort_baseline);
+  CellNumberResult result;
+  result.seed = seed;
+  result.first_step = step;
+  result.cells.push_back(rm->GetNumSimObjects());
+  result.timings.setup = total_time.Seconds();
+  while (step < scenario.steps && reason == StopReason::kCompleted) {
+    auto step_start = std::chrono::steady_clock::now();
+    {
+      TraceSpan trace("ExchangeGhosts");
+      domain.ExchangeGhosts(rm);
+    }
+    {
+      TraceSpan trace("Simulate");
+      scheduler->Simulate(1);
+    }
+    Tracer::Get()->CloseSpans();
+    {
+      TraceSpan trace("MigrateCells");
+      domain.RemoveGhosts(rm);
+      domain.MigrateCells(rm);
+    }
+    step++;
 
-  int i;
-    for (i = 0; i < 50; ++i){
-  simulation.GetScheduler()->Simulate(10);
-  std::cout << (i+1)*10 <<" timesteps past, number of cancer cells: " << rm->GetNumSimObjects() << std::endl;
+    std::chrono::duration<double> step_time =
+        std::chrono::steady_clock::now() - step_start;
+    result.cells.push_back(rm->GetNumSimObjects());
+    result.timings.steps.push_back(step_time.count());
+    if (locality.Update(step, rm, step_time.count()) && scenario.print &&
+        domain.GetRank() == 0) {
+      locality.GetReport().Print();
+    }
+
+    if (scenario.checkpoint_interval != 0 &&
+        step % scenario.checkpoint_interval == 0) {
+      TraceSpan trace("Checkpoint");
+      checkpointer.Write(step, seed, locality.GetBaseline(), rm);
+    }
+    uint64_t num_cells = 0;
+    if (stop.NeedsPopulation() || step % scenario.report_interval == 0) {
+      num_cells = domain.GlobalCellCount(rm);
+    }
+    reason = static_cast<StopReason>(
+        domain.GlobalMax(static_cast<int>(stop.Check(num_cells))));
+    if (reason != StopReason::kCompleted && !stop.NeedsPopulation() &&
+        step % scenario.report_interval != 0) {
+      // stopped (by the time budget) at a timestep without a count
+      num_cells = domain.GlobalCellCount(rm);
+    }
+    if (step % scenario.report_interval == 0 ||
+        reason != StopReason::kCompleted) {
+      if (scenario.print && domain.GetRank() == 0) {
+        std::cout << step <<" timesteps past, number of cancer cells: " << num_cells << std::endl;
+      }
+    }
   }
 
-  std::cout << "In this simulation, cancer cells have 90 percent chance of division" << std::endl;
+  if (Tracer::Get()->IsEnabled()) {
+    Tracer::Get()->Write(simulation.GetOutputDir() + "/trace.json",
+                         domain.GetRank());
+  }
+  result.stop_reason = reason;
+  if (scenario.keep_positions) {
+    result.positions = CollectPositions(rm);
+  }
+  result.timings.total = total_time.Seconds();
+  if (!scenario.print || domain.GetRank() != 0) {
+    return result;
+  }
+  if (reason != StopReason::kCompleted) {
+    std::cout << "Simulation stopped early: " << StopReasonName(reason)
+              << std::endl;
+  }
+  std::cout << "In this simulation, cancer cells have " << scenario.division_probability * 100 << " percent chance of division" << std::endl;
   std::cout << "Simulation completed successfully!" << std::endl;
+  return result;
+}
+
+/// Library entry point: runs the scenario without command line, e.g.
+///   CellNumberScenario scenario;
+///   scenario.print = false;
+///   auto result = RunCellNumber(scenario);
+inline CellNumberResult RunCellNumber(const CellNumberScenario& scenario) {
+  const char* argv[] = {"CellNumber", nullptr};
+  return RunCellNumber(scenario, 1, argv);
+}
+
+inline int Simulate(int argc, const char** argv) {
+  // --resume continues from the last checkpoint
+  bool resume = ExtractOption("resume", &argc, argv);
+  // --trace writes a timeline of the stages per thread to
+  // <output dir>/trace.json
+  if (ExtractOption("trace", &argc, argv)) {
+    Tracer::Get()->Enable();
+  }
+  ScenarioOptions options(&argc, argv);
+  auto scenario = CellNumberScenario::FromOptions(&options);
+  options.CheckAllUsed();
+  scenario.resume = resume;
+  RunCellNumber(scenario, argc, argv);
   return 0;
 }
 
@@ -0,0 +1,55 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#ifndef CELL_RECORD_H_
+#define CELL_RECORD_H_
+
+#include <cstdint>
+#include <cstring>
+
+namespace bdm {
+
+/// Everything needed to recreate one cell exactly: the complete state of
+/// the Cell (volume as well as diameter, and the mechanical state), of its
+/// GrowthModule and its position in memory. Written to checkpoints and sent
+/// with cells that move to another rank (see DomainDecomposition).
+/// Records are compared bytewise, so create them zero-initialized.
+struct CellRecord {
+  uint64_t uid;
+  /// index of the cell in the ResourceManager. The mechanics update the
+  /// cells in place in memory order, so cells are restored in this order
+  /// (which changes when cells are reordered, see LocalityMonitor).
+  uint64_t index;
+  double position[3];
+  double tractor_force[3];
+  double diameter;
+  double volume;
+  double adherence;
+  double density;
+  double x_axis[3];
+  double y_axis[3];
+  double z_axis[3];
+  /// timestep counter of the GrowthModule, which is part of its random seed
+  uint32_t growth_timesteps;
+  uint8_t can_divide;
+  uint8_t has_growth_module;
+  uint8_t padding[2];
+
+  bool operator==(const CellRecord& other) const {
+    return memcmp(this, &other, sizeof(CellRecord)) == 0;
+  }
+};
+
+}  // namespace bdm
+
+#endif  // CELL_RECORD_H_
@@ -0,0 +1,191 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "CellRecord.h"
+#include "biodynamo.h"
+
+namespace bdm {
+
+// Writes periodic checkpoints that only contain what changed since the
+// previous checkpoint: new cells, removed uids and cells whose state changed
+// (position, diameter, ...).
+//
+// <dir>/checkpoints       manifest, one checkpoint file per line, in order
+// <dir>/base-<step>.bin   first checkpoint of a chain (all cells are new)
+// <dir>/delta-<step>.bin  changes since the previous checkpoint
+//
+// A checkpoint file is complete before it is added to the manifest, so a
+// crash while writing never corrupts the chain.
+class Checkpointer {
+ public:
+  using Capture = std::function<CellRecord(SimObject*)>;
+
+  Checkpointer(const std::string& dir, Capture capture)
+      : dir_(dir), capture_(capture) {}
+
+  /// Writes the changes since the previous checkpoint.
+  /// `sort_baseline` is the state of the LocalityMonitor.
+  void Write(uint64_t step, uint64_t seed, double sort_baseline,
+             ResourceManager* rm) {
+    std::map<uint64_t, CellRecord> current;
+    uint64_t index = 0;
+    rm->ApplyOnAllElements([&](SimObject* so) {
+      CellRecord record = capture_(so);
+      record.index = index++;
+      current[record.uid] = record;
+    });
+
+    std::vector<CellRecord> added;
+    std::vector<CellRecord> changed;
+    std::vector<uint64_t> removed;
+    for (auto& entry : current) {
+      auto it = last_.find(entry.first);
+      if (it == last_.end()) {
+        added.push_back(entry.second);
+      } else if (!(it->second == entry.second)) {
+        changed.push_back(entry.second);
+      }
+    }
+    for (auto& entry : last_) {
+      if (current.find(entry.first) == current.end()) {
+        removed.push_back(entry.first);
+      }
+    }
+
+    const bool base = last_.empty();
+    std::string file = (base ? "base-" : "delta-") + std::to_string(step) + ".bin";
+    FILE* f = fopen((dir_ + "/" + file).c_str(), "wb");
+    if (f == nullptr) {
+      Log::Fatal("Checkpointer::Write", "Could not write checkpoint ", file);
+    }
+    uint64_t header[kHeaderSize] = {step, seed, 0, added.size(),
+                                    changed.size(), removed.size()};
+    memcpy(&header[2], &sort_baseline, sizeof(double));
+    bool written =
+        fwrite(Magic(), 1, kMagicSize, f) == kMagicSize &&
+        fwrite(header, sizeof(uint64_t), kHeaderSize, f) == kHeaderSize &&
+        fwrite(added.data(), sizeof(CellRecord), added.size(), f) ==
+            added.size() &&
+        fwrite(changed.data(), sizeof(CellRecord), changed.size(), f) ==
+            changed.size() &&
+        fwrite(removed.data(), sizeof(uint64_t), removed.size(), f) ==
+            removed.size();
+    // fclose writes the rest of the buffer, so a full disk may only show here
+    if (fclose(f) != 0 || !written) {
+      Log::Fatal("Checkpointer::Write", "Could not write checkpoint ", file);
+    }
+
+    if (base) {
+      // a new chain replaces the manifest
+      std::string tmp = dir_ + "/checkpoints.tmp";
+      std::ofstream manifest(tmp);
+      manifest << file << "\n";
+      manifest.close();
+      if (!manifest || rename(tmp.c_str(), (dir_ + "/checkpoints").c_str())) {
+        Log::Fatal("Checkpointer::Write", "Could not write the manifest");
+      }
+    } else {
+      std::ofstream manifest(dir_ + "/checkpoints", std::ios::app);
+      manifest << file << "\n";
+      manifest.close();
+      if (!manifest) {
+        Log::Fatal("Checkpointer::Write", "Could not write the manifest");
+      }
+    }
+    last_.swap(current);
+  }
+
+  /// Starts a new chain with the next Write().
+  /// Needed after a resume, because restored cells get new uids.
+  void Rebase() { last_.clear(); }
+
+  /// Replays all checkpoints of the manifest in `dir`.
+  /// Returns false if there is no checkpoint.
+  static bool Read(const std::string& dir, uint64_t* step, uint64_t* seed,
+                   double* sort_baseline, std::vector<CellRecord>* cells) {
+    std::ifstream manifest(dir + "/checkpoints");
+    std::map<uint64_t, CellRecord> state;
+    std::string file;
+    bool found = false;
+    while (manifest >> file) {
+      FILE* f = fopen((dir + "/" + file).c_str(), "rb");
+      char magic[kMagicSize];
+      uint64_t header[kHeaderSize];
+      if (f == nullptr || fread(magic, 1, sizeof(magic), f) != sizeof(magic) ||
+          memcmp(magic, Magic(), kMagicSize) != 0 ||
+          fread(header, sizeof(uint64_t), kHeaderSize, f) != kHeaderSize) {
+        Log::Fatal("Checkpointer::Read", "Invalid checkpoint ", dir, "/", file);
+      }
+      std::vector<CellRecord> records(header[3] + header[4]);
+      std::vector<uint64_t> removed(header[5]);
+      if (fread(records.data(), sizeof(CellRecord), records.size(), f) !=
+              records.size() ||
+          fread(removed.data(), sizeof(uint64_t), removed.size(), f) !=
+              removed.size()) {
+        Log::Fatal("Checkpointer::Read", "Truncated checkpoint ", dir, "/",
+                   file);
+      }
+      fclose(f);
+
+      for (auto& record : records) {
+        state[record.uid] = record;
+      }
+      for (auto uid : removed) {
+        state.erase(uid);
+      }
+      *step = header[0];
+      *seed = header[1];
+      memcpy(sort_baseline, &header[2], sizeof(double));
+      found = true;
+    }
+
+    // in memory order
+    cells->clear();
+    for (auto& entry : state) {
+      cells->push_back(entry.second);
+    }
+    std::sort(cells->begin(), cells->end(),
+              [](const CellRecord& a, const CellRecord& b) {
+                return a.index < b.index;
+              });
+    return found;
+  }
+
+ private:
+  static const char* Magic() { return "BDMCKPT2"; }
+  static constexpr size_t kMagicSize = 8;
+  /// step, seed, sort baseline, number of added, changed and removed cells
+  static constexpr size_t kHeaderSize = 6;
+
+  std::string dir_;
+  Capture capture_;
+  /// state of the previous checkpoint
+  std::map<uint64_t, CellRecord> last_;
+};
+
+}  // namespace bdm
+
+#endif  // CHECKPOINT_H_
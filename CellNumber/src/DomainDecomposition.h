@@ -0,0 +1,214 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#ifndef DOMAIN_DECOMPOSITION_H_
+#define DOMAIN_DECOMPOSITION_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#ifdef USE_MPI
+#include <mpi.h>
+#endif  // USE_MPI
+
+#include "CellRecord.h"
+#include "biodynamo.h"
+
+namespace bdm {
+
+// Splits the simulation space into slabs along the x axis, one slab per MPI
+// rank. Every rank simulates the cells inside its slab.
+//  - Before a timestep, cells close to a slab boundary are copied to the
+//    neighbouring rank as ghost cells. Ghost cells have no biology module, so
+//    they only push the cells of the neighbouring rank.
+//  - After a timestep, the ghost cells are removed and cells that left the
+//    slab (e.g. daughters after Divide()) are moved to the neighbouring rank.
+// Cells are sent as CellRecords, so a cell that moves to another rank keeps
+// its complete state (volume, mechanical state, GrowthModule) and continues
+// exactly as it would have on a single rank.
+// Without USE_MPI there is a single slab and all exchanges do nothing.
+class DomainDecomposition {
+ public:
+  /// Records the state of a cell that is sent to another rank
+  using Capture = std::function<CellRecord(SimObject*)>;
+  /// Creates the simulation object of a cell that was received from another
+  /// rank. `ghost` is true for ghost cells, which get no biology module.
+  using Restore =
+      std::function<SimObject*(const CellRecord& record, bool ghost)>;
+
+  DomainDecomposition(double min_bound, double max_bound, Capture capture,
+                      Restore restore)
+      : capture_(capture), restore_(restore) {
+#ifdef USE_MPI
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank_);
+    MPI_Comm_size(MPI_COMM_WORLD, &size_);
+#endif  // USE_MPI
+    double width = (max_bound - min_bound) / size_;
+    lower_ = min_bound + rank_ * width;
+    upper_ = rank_ == size_ - 1 ? max_bound : lower_ + width;
+  }
+
+  int GetRank() const { return rank_; }
+  int GetSize() const { return size_; }
+
+  /// Returns true if the position lies in the slab of this rank.
+  bool Owns(const Double3& position) const {
+    return position[0] >= lower_ &&
+           (position[0] < upper_ || rank_ == size_ - 1);
+  }
+
+  /// Sends copies of the cells within the halo of a slab boundary to the
+  /// neighbouring rank and creates the received ghost cells.
+  void ExchangeGhosts(ResourceManager* rm) {
+    if (size_ == 1) {
+      return;
+    }
+    std::vector<CellRecord> to_left;
+    std::vector<CellRecord> to_right;
+    rm->ApplyOnAllElements([&](SimObject* so) {
+      const auto& pos = so->GetPosition();
+      if (pos[0] < lower_ + kHaloWidth) {
+        Pack(so, &to_left);
+      }
+      if (pos[0] >= upper_ - kHaloWidth) {
+        Pack(so, &to_right);
+      }
+    });
+    for (auto* so : Unpack(Exchange(to_left, to_right), true)) {
+      ghosts_.push_back(so->GetUid());
+      rm->push_back(so);
+    }
+  }
+
+  /// Removes the ghost cells created by the last ExchangeGhosts() call.
+  void RemoveGhosts(ResourceManager* rm) {
+    for (auto uid : ghosts_) {
+      rm->Remove(uid);
+    }
+    ghosts_.clear();
+  }
+
+  /// Moves cells that left the slab of this rank to the neighbouring rank.
+  void MigrateCells(ResourceManager* rm) {
+    if (size_ == 1) {
+      return;
+    }
+    std::vector<CellRecord> to_left;
+    std::vector<CellRecord> to_right;
+    std::vector<SoUid> leaving;
+    rm->ApplyOnAllElements([&](SimObject* so) {
+      const auto& pos = so->GetPosition();
+      if (pos[0] < lower_ && rank_ != 0) {
+        Pack(so, &to_left);
+        leaving.push_back(so->GetUid());
+      } else if (pos[0] >= upper_ && rank_ != size_ - 1) {
+        Pack(so, &to_right);
+        leaving.push_back(so->GetUid());
+      }
+    });
+    for (auto uid : leaving) {
+      rm->Remove(uid);
+    }
+    for (auto* so : Unpack(Exchange(to_left, to_right), false)) {
+      rm->push_back(so);
+    }
+  }
+
+  /// Number of cells of all ranks. Must be called by every rank.
+  uint64_t GlobalCellCount(ResourceManager* rm) const {
+    uint64_t local = rm->GetNumSimObjects() - ghosts_.size();
+#ifdef USE_MPI
+    uint64_t global = 0;
+    MPI_Allreduce(&local, &global, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+    return global;
+#else
+    return local;
+#endif  // USE_MPI
+  }
+
+  /// Largest value of all ranks, e.g. to agree on a decision that depends on
+  /// the clock of each rank. Must be called by every rank.
+  int GlobalMax(int value) const {
+#ifdef USE_MPI
+    int global = value;
+    MPI_Allreduce(&value, &global, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    return global;
+#else
+    return value;
+#endif  // USE_MPI
+  }
+
+ private:
+  /// Cells closer than kHaloWidth to a slab boundary are sent as ghosts.
+  /// Larger than the largest cell diameter (8), which is the interaction
+  /// radius of the mechanical forces.
+  static constexpr double kHaloWidth = 10;
+  int rank_ = 0;
+  int size_ = 1;
+  double lower_;
+  double upper_;
+  Capture capture_;
+  Restore restore_;
+  std::vector<SoUid> ghosts_;
+
+  void Pack(SimObject* so, std::vector<CellRecord>* buffer) const {
+    buffer->push_back(capture_(so));
+  }
+
+  std::vector<SimObject*> Unpack(const std::vector<CellRecord>& buffer,
+                                 bool ghost) const {
+    std::vector<SimObject*> cells;
+    for (auto& record : buffer) {
+      cells.push_back(restore_(record, ghost));
+    }
+    return cells;
+  }
+
+  /// Sends the buffers to the left and right neighbour and returns what the
+  /// neighbours sent to this rank.
+  std::vector<CellRecord> Exchange(
+      const std::vector<CellRecord>& to_left,
+      const std::vector<CellRecord>& to_right) const {
+    std::vector<CellRecord> received;
+#ifdef USE_MPI
+    // a record is sent as one element of sizeof(CellRecord) bytes
+    MPI_Datatype record;
+    MPI_Type_contiguous(sizeof(CellRecord), MPI_BYTE, &record);
+    MPI_Type_commit(&record);
+    int left = rank_ == 0 ? MPI_PROC_NULL : rank_ - 1;
+    int right = rank_ == size_ - 1 ? MPI_PROC_NULL : rank_ + 1;
+    uint64_t send_sizes[2] = {to_left.size(), to_right.size()};
+    uint64_t from_right = 0;
+    uint64_t from_left = 0;
+    MPI_Sendrecv(&send_sizes[0], 1, MPI_UINT64_T, left, 0, &from_right, 1,
+                 MPI_UINT64_T, right, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(&send_sizes[1], 1, MPI_UINT64_T, right, 1, &from_left, 1,
+                 MPI_UINT64_T, left, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    received.resize(from_right + from_left);
+    MPI_Sendrecv(to_left.data(), static_cast<int>(to_left.size()), record,
+                 left, 2, received.data(), static_cast<int>(from_right),
+                 record, right, 2, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    MPI_Sendrecv(to_right.data(), static_cast<int>(to_right.size()), record,
+                 right, 3, received.data() + from_right,
+                 static_cast<int>(from_left), record, left, 3, MPI_COMM_WORLD,
+                 MPI_STATUS_IGNORE);
+    MPI_Type_free(&record);
+#endif  // USE_MPI
+    return received;
+  }
+};
+
+}  // namespace bdm
+
+#endif  // DOMAIN_DECOMPOSITION_H_
@@ -0,0 +1,63 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+//
+// Check of the checkpoints (run with ctest): a run that is interrupted after
+// a checkpoint and resumed from it must end with exactly the same cells as
+// an uninterrupted run with the same seed.
+// Returns 1 if the positions differ.
+
+#include <omp.h>
+#include <cstdio>
+#include <cstring>
+
+#include "CellNumber.h"
+
+using namespace bdm;
+
+int main() {
+  // The mechanics move the cells in place, so with several threads even two
+  // uninterrupted runs differ.
+  omp_set_num_threads(1);
+
+  CellNumberScenario scenario;
+  scenario.seed = 4357;
+  // about 2000 cells at the checkpoint, so they have been reordered (see
+  // LocalityMonitor::kMinCells) and the memory order matters
+  scenario.steps = 600;
+  scenario.checkpoint_interval = 450;
+  scenario.sort_check_interval = 30;
+  scenario.print = false;
+  scenario.keep_positions = true;
+  auto uninterrupted = RunCellNumber(scenario);
+
+  // interrupted right after the checkpoint, then resumed
+  scenario.steps = scenario.checkpoint_interval;
+  RunCellNumber(scenario);
+  scenario.steps = 600;
+  scenario.resume = true;
+  auto resumed = RunCellNumber(scenario);
+
+  const auto& a = uninterrupted.positions;
+  const auto& b = resumed.positions;
+  size_t mismatches = a.size() == b.size() ? 0 : 1;
+  for (size_t i = 0; i < a.size() && i < b.size(); i++) {
+    if (memcmp(&a[i], &b[i], sizeof(Double3)) != 0) {
+      mismatches++;
+    }
+  }
+  std::printf("%zu cells uninterrupted, %zu cells resumed, %zu positions "
+              "differ\n",
+              a.size(), b.size(), mismatches);
+  return mismatches == 0 ? 0 : 1;
+}
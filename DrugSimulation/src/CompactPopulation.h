@@ -0,0 +1,183 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#ifndef COMPACT_POPULATION_H_
+#define COMPACT_POPULATION_H_
+
+#include <omp.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "DrugSimulation.h"
+#include "work_stealing.h"
+
+namespace bdm {
+
+// Cells of the drug scenarios without mechanics (engine = "compact").
+//
+// The drug scenarios only use the position and the diameter of a cell, but a
+// MyCell carries the complete state of Cell (mass location, tractor force,
+// adherence, density, biology modules, ...) in double precision. Here a cell
+// is a float position, a float diameter and the index of its DrugContext,
+// 17 bytes stored as separate arrays, so the dose response streams through
+// memory and 1e7 cells need less than 200 MB.
+//
+// Cells do not push each other; the dose response is the same as in
+// ChemicalDrugBM (see ApplyDrug).
+//
+// The random numbers of a cell come from a CounterRandom keyed by the seed,
+// the timestep and the index of the cell, and the order of the cells after
+// a timestep does not depend on the chunks, so a run gives the same result
+// on any number of threads.
+class CompactPopulation {
+ public:
+  /// `contexts[i]` is the DrugContext of the cells with context index i
+  CompactPopulation(const std::vector<const DrugContext*>& contexts,
+                    uint64_t seed, double min_bound, double max_bound)
+      : contexts_(contexts),
+        seed_(CounterRandom::Mix(seed)),
+        min_bound_(static_cast<float>(min_bound)),
+        max_bound_(static_cast<float>(max_bound)) {}
+
+  void Reserve(size_t num_cells) {
+    x_.reserve(num_cells);
+    y_.reserve(num_cells);
+    z_.reserve(num_cells);
+    diameter_.reserve(num_cells);
+    context_.reserve(num_cells);
+  }
+
+  void Add(const Double3& position, double diameter, uint8_t context = 0) {
+    x_.push_back(static_cast<float>(position[0]));
+    y_.push_back(static_cast<float>(position[1]));
+    z_.push_back(static_cast<float>(position[2]));
+    diameter_.push_back(static_cast<float>(diameter));
+    context_.push_back(context);
+  }
+
+  size_t GetNumCells() const { return x_.size(); }
+
+  Double3 GetPosition(size_t i) const { return {x_[i], y_[i], z_[i]}; }
+  double GetDiameter(size_t i) const { return diameter_[i]; }
+
+  /// Thread utilization of all steps so far
+  const WorkStealingFor& GetLoop() const { return loop_; }
+
+  /// Timestep `step`: every cell responds to the drug at its position in
+  /// parallel. The cells are processed by a work-stealing loop in chunks of
+  /// the same number of cells, and threads that finish early (e.g. because
+  /// many of their cells died) take over chunks of the others. Dead cells
+  /// are removed and daughters are appended afterwards, in the order of
+  /// their mothers.
+  void Step(uint64_t step) {
+    const size_t n = GetNumCells();
+    alive_.assign(n, 1);
+    auto chunks = loop_.MakeChunks(n);
+    daughters_.resize(chunks.size() - 1);
+    const uint64_t key = CounterRandom::Mix(seed_ ^ step);
+    loop_.Run(chunks, [&](size_t chunk, size_t begin, size_t end) {
+      auto* daughters = &daughters_[chunk];
+      daughters->clear();
+      TraceExtend trace("DrugResponse");
+      for (size_t i = begin; i < end; i++) {
+        CounterRandom random(CounterRandom::Mix(key ^ i));
+        switch (ApplyDrug(*contexts_[context_[i]], GetPosition(i), &random)) {
+          case DrugResponse::kDie:
+            alive_[i] = 0;
+            break;
+          case DrugResponse::kDivide:
+            Divide(i, &random, daughters);
+            break;
+          case DrugResponse::kSurvive:
+            break;
+        }
+      }
+    });
+
+    size_t kept = 0;
+    for (size_t i = 0; i < n; i++) {
+      if (alive_[i]) {
+        x_[kept] = x_[i];
+        y_[kept] = y_[i];
+        z_[kept] = z_[i];
+        diameter_[kept] = diameter_[i];
+        context_[kept] = context_[i];
+        kept++;
+      }
+    }
+    x_.resize(kept);
+    y_.resize(kept);
+    z_.resize(kept);
+    diameter_.resize(kept);
+    context_.resize(kept);
+    for (auto& daughters : daughters_) {
+      for (auto& d : daughters) {
+        x_.push_back(d.x);
+        y_.push_back(d.y);
+        z_.push_back(d.z);
+        diameter_.push_back(d.diameter);
+        context_.push_back(d.context);
+      }
+    }
+  }
+
+ private:
+  struct Daughter {
+    float x, y, z, diameter;
+    uint8_t context;
+  };
+
+  std::vector<const DrugContext*> contexts_;
+  uint64_t seed_;
+  float min_bound_;
+  float max_bound_;
+  std::vector<float> x_;
+  std::vector<float> y_;
+  std::vector<float> z_;
+  std::vector<float> diameter_;
+  std::vector<uint8_t> context_;
+  /// 0 for the cells that die in the current step
+  std::vector<uint8_t> alive_;
+  /// daughters of the current step per chunk
+  std::vector<std::vector<Daughter>> daughters_;
+  WorkStealingFor loop_;
+
+  /// Like Cell::Divide: the volume is split in half and mother and daughter
+  /// move apart along a random direction, by half of their new diameter.
+  void Divide(size_t i, CounterRandom* random,
+              std::vector<Daughter>* daughters) {
+    const float diameter = diameter_[i] * 0.7937005f;  // cbrt(1/2)
+    const double phi = random->Uniform(0, 2 * Math::kPi);
+    const double cos_theta = random->Uniform(-1, 1);
+    const double sin_theta = std::sqrt(1 - cos_theta * cos_theta);
+    const float dx = static_cast<float>(0.25 * diameter * sin_theta * std::cos(phi));
+    const float dy = static_cast<float>(0.25 * diameter * sin_theta * std::sin(phi));
+    const float dz = static_cast<float>(0.25 * diameter * cos_theta);
+    daughters->push_back({Clamp(x_[i] + dx), Clamp(y_[i] + dy),
+                          Clamp(z_[i] + dz), diameter, context_[i]});
+    x_[i] = Clamp(x_[i] - dx);
+    y_[i] = Clamp(y_[i] - dy);
+    z_[i] = Clamp(z_[i] - dz);
+    diameter_[i] = diameter;
+  }
+
+  float Clamp(float value) const {
+    return std::min(std::max(value, min_bound_), max_bound_);
+  }
+};
+
+}  // namespace bdm
+
+#endif  // COMPACT_POPULATION_H_
@@ -0,0 +1,510 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#include "DrugSimulation.h"
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+#include "CompactPopulation.h"
+#include "command_line.h"
+#include "result_cache.h"
+#include "scenario_options.h"
+
+namespace bdm {
+
+namespace {
+
+template <typename TRandom>
+DrugResponse ApplyDrugImpl(const DrugContext& context, const Double3& position,
+                           TRandom* random) {
+  auto* grid = context.grid;
+  // get concentraion at current cell position
+  double current_concentration = grid->GetConcentration(position);
+
+  // Consider one timestep as an hour, one day have 24 timesteps
+  // P is proportion for remaining cells
+  double P = context.model->proportion(current_concentration);
+  DrugResponse response = DrugResponse::kSurvive;
+  if (context.model->proliferates(current_concentration, P)) {
+    if (random->Uniform(0.0, 1.0) < P - 1) {
+      response = DrugResponse::kDivide;
+      context.counters->RecordBirth();
+    }
+  } else {
+    if (random->Uniform(0.0, 1.0) > P) {
+      context.counters->RecordDeath();
+      return DrugResponse::kDie;
+    }
+  }
+  context.counters->RecordSurvivor();
+
+  // Living cells consume the drug. The concentration of the grid changes
+  // only after all cells ran (FloatDiffusionGrid::MergeUptake).
+  if (context.uptake_rate > 0) {
+    grid->Uptake(position, std::min(1.0, context.uptake_rate * kHoursPerStep) *
+                               current_concentration);
+  }
+  return response;
+}
+
+}  // namespace
+
+DrugResponse ApplyDrug(const DrugContext& context, const Double3& position,
+                       Random* random) {
+  return ApplyDrugImpl(context, position, random);
+}
+
+DrugResponse ApplyDrug(const DrugContext& context, const Double3& position,
+                       CounterRandom* random) {
+  return ApplyDrugImpl(context, position, random);
+}
+
+void ChemicalDrugBM::Run(SimObject* so) {
+  TraceExtend trace("ChemicalDrugBM");
+  auto* random = Simulation::GetActive()->GetRandom();
+  auto* cell = bdm_static_cast<Cell*>(so);
+  switch (ApplyDrug(*context_, so->GetPosition(), random)) {
+    case DrugResponse::kDivide:
+      cell->Divide();
+      break;
+    case DrugResponse::kDie:
+      cell->RemoveFromSimulation();
+      break;
+    case DrugResponse::kSurvive:
+      break;
+  }
+}
+
+DrugScenario DrugScenario::FromOptions(ScenarioOptions* options) {
+  DrugScenario scenario;
+  std::stringstream drugs(options->GetString("drug", ""));
+  std::string name;
+  while (std::getline(drugs, name, ',')) {
+    scenario.drugs.push_back(name);
+  }
+  scenario.cell_count = options->GetInt("cell_count", scenario.cell_count, 1, 1e9);
+  scenario.cell_diameter =
+      options->GetDouble("cell_diameter", scenario.cell_diameter, 0.1, 100);
+  scenario.concentration =
+      options->GetDouble("concentration", scenario.concentration, 0, 1e6);
+  if (options->Has("diffusion_coefficient")) {
+    scenario.diffusion_coefficient =
+        options->GetDouble("diffusion_coefficient", 0, 0, 1e6);
+  }
+  std::string method = options->GetString("diffusion_method", "euler");
+  if (method == "implicit") {
+    scenario.diffusion_method = DiffusionMethod::kImplicit;
+  } else if (method != "euler") {
+    Log::Fatal("DrugScenario", "diffusion_method must be euler or implicit, got ",
+               method);
+  }
+  if (options->Has("decay_constant")) {
+    scenario.decay_constant = options->GetDouble("decay_constant", 0, 0, 1e3);
+  }
+  scenario.report_steps =
+      options->GetIntList("report_steps", scenario.report_steps, 1, 1e6);
+  for (size_t i = 1; i < scenario.report_steps.size(); i++) {
+    if (scenario.report_steps[i] <= scenario.report_steps[i - 1]) {
+      Log::Fatal("DrugScenario", "report_steps must be increasing");
+    }
+  }
+  scenario.min_bound =
+      options->GetDouble("min_bound", scenario.min_bound, -1e6, 1e6);
+  scenario.max_bound =
+      options->GetDouble("max_bound", scenario.max_bound, -1e6, 1e6);
+  if (scenario.min_bound >= scenario.max_bound) {
+    Log::Fatal("DrugScenario", "min_bound must be smaller than max_bound");
+  }
+  scenario.uptake_rate =
+      options->GetDouble("uptake_rate", scenario.uptake_rate, 0, 1e6);
+  std::string engine = options->GetString("engine", "biodynamo");
+  if (engine == "compact") {
+    scenario.engine = DrugEngine::kCompact;
+  } else if (engine != "biodynamo") {
+    Log::Fatal("DrugScenario", "engine must be biodynamo or compact, got ",
+               engine);
+  }
+  scenario.resolution =
+      options->GetInt("resolution", scenario.resolution, 1, 1000);
+  scenario.seed = options->GetInt("seed", scenario.seed, 0, INT64_MAX);
+  scenario.result_cache = options->GetString("result_cache", "");
+  scenario.monitor_interval = options->GetDouble(
+      "monitor_interval", scenario.monitor_interval, 0, 1e6);
+  scenario.stop = StopConditions::FromOptions(options);
+  return scenario;
+}
+
+#ifndef DRUG_MODEL_VERSION
+// set by CMakeLists.txt, a hash of the model code
+#define DRUG_MODEL_VERSION "unknown"
+#endif  // DRUG_MODEL_VERSION
+
+namespace {
+
+std::string ToText(const DrugResult& result) {
+  std::stringstream text;
+  text << "stop_reason " << static_cast<int>(result.stop_reason) << "\n";
+  for (auto& report : result.reports) {
+    text << "report " << report.step << " " << report.cells << " "
+         << report.births << " " << report.deaths << "\n";
+  }
+  text << "cells";
+  for (auto cells : result.cells) {
+    text << " " << cells;
+  }
+  text << "\n";
+  return text.str();
+}
+
+bool FromText(const std::string& text, DrugResult* result) {
+  std::stringstream lines(text);
+  std::string line;
+  while (std::getline(lines, line)) {
+    std::stringstream fields(line);
+    std::string key;
+    fields >> key;
+    if (key == "stop_reason") {
+      int reason;
+      fields >> reason;
+      result->stop_reason = static_cast<StopReason>(reason);
+    } else if (key == "report") {
+      DrugResult::Report report;
+      fields >> report.step >> report.cells >> report.births >> report.deaths;
+      result->reports.push_back(report);
+    } else if (key == "cells") {
+      uint64_t cells;
+      while (fields >> cells) {
+        result->cells.push_back(cells);
+      }
+    }
+    if (fields.fail() && !fields.eof()) {
+      return false;
+    }
+  }
+  return !result->cells.empty();
+}
+
+/// random_seed of the [simulation] section of the bdm.toml that Simulation
+/// reads (see FindConfigFile), so it is known before the Simulation is
+/// created
+uint64_t ConfiguredRandomSeed() {
+  Param defaults;
+  const std::string file = FindConfigFile();
+  if (file.empty()) {
+    return defaults.random_seed_;
+  }
+  auto seed = cpptoml::parse_file(file)->get_qualified_as<int64_t>(
+      "simulation.random_seed");
+  return seed ? static_cast<uint64_t>(*seed) : defaults.random_seed_;
+}
+
+void PrintReport(const DrugResult::Report& report) {
+  std::cout <<"cell numbers after "<< report.step <<"h of drug treatment: " <<report.cells
+            <<" (births: "<< report.births <<", deaths: "<< report.deaths <<")"<< std::endl;
+}
+
+}  // namespace
+
+DrugResult SimulateDrug(const DrugModel& model, const DrugScenario& scenario,
+                        int argc, const char** argv) {
+  Stopwatch total_time;
+  const uint64_t seed =
+      scenario.seed != 0 ? scenario.seed : ConfiguredRandomSeed();
+  auto set_param = [&](Param* param) {
+    param->bound_space_ = true;
+    param->min_bound_ = scenario.min_bound;
+    param->max_bound_ = scenario.max_bound;
+    param->random_seed_ = seed;
+    // every drug writes its files into its own directory
+    param->output_dir_ += "/" + model.name;
+  };
+
+  // Define the substance in our simulation
+  // Concentrations are stored in single precision, see FloatDiffusionGrid.
+  // Order: substance_name, diffusion_coefficient, decay_constant, resolution
+  double diffusion_coefficient = scenario.diffusion_coefficient < 0
+                                     ? model.diffusion_coefficient
+                                     : scenario.diffusion_coefficient;
+  double decay_constant = scenario.decay_constant < 0
+                              ? model.decay_constant
+                              : scenario.decay_constant;
+
+  // The result is determined by the model code, everything that is hashed
+  // here and the number of threads (cells are processed in parallel).
+  // A cached result is returned before the Simulation is created.
+  std::unique_ptr<ResultCache> cache;
+  uint64_t key = 0;
+  if (!scenario.result_cache.empty()) {
+    cache.reset(new ResultCache(scenario.result_cache));
+    Fnv1aHash hash;
+    hash.Add(std::string(DRUG_MODEL_VERSION))
+        .Add(model.name)
+        .Add(scenario.cell_count)
+        .Add(scenario.cell_diameter)
+        .Add(scenario.concentration)
+        .Add(diffusion_coefficient)
+        .Add(decay_constant)
+        .Add(scenario.diffusion_method)
+        .Add(scenario.uptake_rate)
+        .Add(scenario.engine)
+        .Add(scenario.report_steps)
+        .Add(scenario.min_bound)
+        .Add(scenario.max_bound)
+        .Add(scenario.resolution)
+        .Add(scenario.stop.extinction)
+        .Add(scenario.stop.max_population)
+        .Add(scenario.stop.steady_state_epsilon)
+        .Add(scenario.stop.steady_state_steps)
+        .Add(scenario.stop.time_budget)
+        .Add(seed)
+        .Add(kHoursPerStep)
+        .Add(omp_get_max_threads());
+    key = hash.Get();
+
+    std::string text;
+    DrugResult result;
+    if (!scenario.keep_positions && cache->Load(key, &text) &&
+        FromText(text, &result)) {
+      result.cached = true;
+      result.timings.total = total_time.Seconds();
+      if (!scenario.print) {
+        return result;
+      }
+      std::cout <<"Drug name: "<< model.name <<" Drug concentration: "<< scenario.concentration<< " uM (cached result)"<<std::endl;
+      std::cout <<"Initial cell numbers: "<< result.cells[0] << std::endl;
+      for (auto& report : result.reports) {
+        PrintReport(report);
+      }
+      if (result.stop_reason != StopReason::kCompleted) {
+        std::cout << "Simulation stopped early: "
+                  << StopReasonName(result.stop_reason) << std::endl;
+      }
+      return result;
+    }
+  }
+
+  Simulation simulation(argc, argv, set_param);
+  auto* rm = simulation.GetResourceManager();
+  auto* param = simulation.GetParam();
+  auto* myrand = simulation.GetRandom();
+
+  FloatDiffusionGrid grid(model.name, diffusion_coefficient, decay_constant,
+                          scenario.resolution);
+  grid.SetDiffusionMethod(scenario.diffusion_method);
+  grid.Initialize(param->min_bound_, param->max_bound_);
+
+  // Init substance with linear concentration distribution along the z axis
+  //  LinearConcentration<axis>(double startvalue, double endvalue, double startpos, double endpos)
+  double concentration = scenario.concentration;
+  if (model.end_factor == 1) {
+    grid.Fill(concentration);
+  } else {
+    grid.RunAxisInitializer<Axis::kZAxis>(LinearConcentration<Axis::kZAxis>(
+        concentration, concentration * model.end_factor, 0, 100));
+  }
+
+  // live births, deaths and survivors
+  PopulationCounters counters;
+
+  DrugContext context;
+  context.model = &model;
+  context.grid = &grid;
+  context.counters = &counters;
+  context.uptake_rate = scenario.uptake_rate;
+  if (context.uptake_rate > 0) {
+    grid.EnableUptake();
+  }
+
+  size_t nb_of_cells = scenario.cell_count;  // number of cells in the simulation
+  double x_coord, y_coord, z_coord;
+
+  // engine = "compact": cells without mechanics, see CompactPopulation
+  const bool compact = scenario.engine == DrugEngine::kCompact;
+  CompactPopulation population({&context}, param->random_seed_,
+                               param->min_bound_, param->max_bound_);
+  if (compact) {
+    population.Reserve(nb_of_cells);
+  }
+
+  for (size_t i = 0; i < nb_of_cells; ++i) {
+    // The simulation starts with a cell cube (300*300*300 by default)
+    // random double between min_bound and max_bound
+    x_coord = myrand->Uniform(param->min_bound_, param->max_bound_);
+    y_coord = myrand->Uniform(param->min_bound_, param->max_bound_);
+    z_coord = myrand->Uniform(param->min_bound_, param->max_bound_);
+
+    if (compact) {
+      population.Add({x_coord, y_coord, z_coord}, scenario.cell_diameter);
+      continue;
+    }
+    // creating the cell at position x, y, z
+    MyCell* cell = new MyCell({x_coord, y_coord, z_coord});
+    // set cell parameters
+    cell->SetDiameter(scenario.cell_diameter);
+    cell->AddBiologyModule(new ChemicalDrugBM(&context));
+    rm->push_back(cell);  // put the created cell in our cells structure
+  }
+  auto num_cells = [&]() -> uint64_t {
+    return compact ? population.GetNumCells() : rm->GetNumSimObjects();
+  };
+
+  // The substance diffuses and decays at the start of every timestep, the
+  // uptake of the cells is subtracted at its end.
+  // Gradients are only calculated for the timesteps that are exported.
+  // The simulation ends early if a stop condition holds (e.g. extinction).
+  auto* scheduler = simulation.GetScheduler();
+  auto* tracer = Tracer::Get();
+  StopMonitor stop(scenario.stop);
+  DrugResult result;
+  result.cells.push_back(num_cells());
+  uint64_t step = 0;
+  Stopwatch step_time;
+  auto simulate = [&](uint64_t steps) {
+    for (uint64_t i = 0; i < steps; i++) {
+      step_time.Restart();
+      counters.StartStep();
+      // as in the BioDynaMo scheduler, the substance is updated before the
+      // cells respond to it; a timestep is one hour (kHoursPerStep)
+      {
+        TraceSpan trace("Diffuse");
+        grid.Diffuse(kHoursPerStep);
+      }
+      if (compact) {
+        TraceSpan trace("CompactPopulation");
+        population.Step(step);
+      } else {
+        TraceSpan trace("Simulate");
+        scheduler->Simulate(1);
+      }
+      tracer->CloseSpans();
+      {
+        TraceSpan trace("MergeUptake");
+        grid.MergeUptake();
+      }
+      step++;
+      if (param->export_visualization_ &&
+          step % param->visualization_export_interval_ == 0) {
+        TraceSpan trace("ExportVtk");
+        grid.ExportVtk(simulation.GetOutputDir() + "/" + model.name + "-" +
+                       std::to_string(step) + ".vtk");
+      }
+      result.cells.push_back(num_cells());
+      result.timings.steps.push_back(step_time.Seconds());
+      StopReason reason = stop.Check(result.cells.back());
+      if (reason != StopReason::kCompleted) {
+        return reason;
+      }
+    }
+    return StopReason::kCompleted;
+  };
+
+  // Run simulation for 72 hours (the last report step)
+  if (scenario.print) {
+    std::cout <<"Drug name: "<< model.name <<" Drug concentration: "<< concentration<< " uM"<<std::endl;
+    std::cout <<"Initial cell numbers: "<< nb_of_cells << std::endl;
+  }
+  std::unique_ptr<PopulationMonitor> monitor;
+  if (scenario.print && scenario.monitor_interval > 0) {
+    // reads the counters while the timesteps run
+    monitor.reset(new PopulationMonitor(scenario.monitor_interval, [&]() {
+      auto live = counters.Read();
+      std::stringstream msg;
+      msg << "[" << model.name << "] births: " << live.births
+          << " deaths: " << live.deaths
+          << " survivors in current step: " << live.survivors << "\n";
+      std::cout << msg.str() << std::flush;
+    }));
+  }
+  result.timings.setup = total_time.Seconds();
+  for (auto report_step : scenario.report_steps) {
+    result.stop_reason = simulate(report_step - step);
+    auto total = counters.Read();
+    result.reports.push_back({step, num_cells(), total.births, total.deaths});
+    if (scenario.print) {
+      PrintReport(result.reports.back());
+    }
+    if (result.stop_reason != StopReason::kCompleted) {
+      if (scenario.print) {
+        std::cout << "Simulation stopped early: "
+                  << StopReasonName(result.stop_reason) << std::endl;
+      }
+      break;
+    }
+  }
+  monitor.reset();
+  if (scenario.keep_positions && compact) {
+    result.positions.reserve(population.GetNumCells());
+    for (size_t i = 0; i < population.GetNumCells(); i++) {
+      result.positions.push_back(population.GetPosition(i));
+    }
+  } else if (scenario.keep_positions) {
+    result.positions = CollectPositions(rm);
+  }
+  if (compact && scenario.print) {
+    population.GetLoop().PrintStatistics("CompactPopulation");
+  }
+  if (tracer->IsEnabled()) {
+    tracer->Write(simulation.GetOutputDir() + "/trace.json");
+  }
+  // a run that hit its wall-clock budget depends on the machine
+  if (cache && result.stop_reason != StopReason::kTimeBudget) {
+    cache->Store(key, ToText(result));
+  }
+  result.timings.total = total_time.Seconds();
+  return result;
+}
+
+DrugResult SimulateDrug(const DrugModel& model, const DrugScenario& scenario) {
+  const char* argv[] = {"DrugSimulation", nullptr};
+  return SimulateDrug(model, scenario, 1, argv);
+}
+
+int Simulate(int argc, const char** argv) {
+  auto* registry = DrugRegistry::Get();
+  if (ExtractOption("trace", &argc, argv)) {
+    Tracer::Get()->Enable();
+  }
+  ScenarioOptions options(&argc, argv);
+  DrugScenario scenario = DrugScenario::FromOptions(&options);
+  options.CheckAllUsed();
+  if (scenario.drugs.empty()) {
+    std::stringstream names;
+    for (auto& name : registry->GetNames()) {
+      names << " " << name;
+    }
+    Log::Fatal("Simulate", "Select the drugs with --drug=<name>[,<name>...]. ",
+               "Available drugs:", names.str());
+  }
+
+  // check all names before the first simulation starts
+  std::vector<const DrugModel*> models;
+  for (auto& name : scenario.drugs) {
+    const DrugModel* model = registry->Find(name);
+    if (model == nullptr) {
+      Log::Fatal("Simulate", "Unknown drug ", name);
+    }
+    models.push_back(model);
+  }
+
+  // a drug that stops early (e.g. all cells are dead) does not affect the
+  // simulation of the next one
+  for (auto* model : models) {
+    SimulateDrug(*model, scenario, argc, argv);
+  }
+  return 0;
+}
+
+}  // namespace bdm
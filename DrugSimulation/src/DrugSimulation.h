@@ -0,0 +1,285 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#ifndef DRUG_SIMULATION_H_
+#define DRUG_SIMULATION_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "biodynamo.h"
+#include "core/substance_initializers.h"
+#include "counter_random.h"
+#include "float_diffusion_grid.h"
+#include "population_counters.h"
+#include "run_result.h"
+#include "stop_conditions.h"
+#include "trace.h"
+
+namespace bdm {
+
+// Concentration that changes linearly along the axis kAxis, from startvalue
+// at startpos to endvalue at endpos. The axis is a template parameter, so
+// there is no switch per box (see FloatDiffusionGrid::RunAxisInitializer).
+template <Axis kAxis>
+struct LinearConcentration {
+    double slope_;
+    double intercept_;
+    LinearConcentration(double startvalue, double endvalue, double startpos, double endpos) {
+        slope_ = (endvalue - startvalue) / (endpos - startpos);
+        intercept_ = startvalue - (slope_ * startpos);
+    }
+    /// concentration at the coordinate `pos` along kAxis
+    double operator()(double pos) const { return (slope_ * pos) + intercept_; }
+    double operator()(double x, double y, double z) const {
+        return (*this)(kAxis == Axis::kXAxis ? x : kAxis == Axis::kYAxis ? y : z);
+    }
+};
+
+/// A timestep of the drug scenarios is one hour: the dose-response fits give
+/// the proportion of cells after one hour, and the decay constants and
+/// diffusion coefficients of the drugs are per hour.
+constexpr double kHoursPerStep = 1;
+
+// Dose-response model of a drug.
+// Every timestep (one hour) a cell draws a random number r between 0 and 1.
+// If the cell proliferates at the concentration at its position, it divides
+// if r < P-1, otherwise it dies if r > P.
+struct DrugModel {
+  /// name of the drug, also used as substance name
+  std::string name;
+  /// order of DefineSubstance: diffusion_coefficient, decay_constant
+  double diffusion_coefficient;
+  double decay_constant;
+  /// The initial concentration decreases linearly along the z axis, from
+  /// the given concentration at z = 0 to concentration * end_factor at
+  /// z = 100 (1 for a uniform concentration, which uses a faster fill).
+  double end_factor;
+  /// P is proportion for remaining cells after one hour
+  double (*proportion)(double concentration);
+  /// true if cells divide (instead of die) at this concentration
+  bool (*proliferates)(double concentration, double proportion);
+};
+
+// All drug models that are compiled into the library.
+// Drug models register themselves with a static DrugRegistration object
+// (see src/drugs), so a new drug only needs a new source file.
+class DrugRegistry {
+ public:
+  static DrugRegistry* Get() {
+    static DrugRegistry registry;
+    return &registry;
+  }
+
+  void Register(const DrugModel& model) { models_[model.name] = model; }
+
+  /// Returns nullptr if there is no drug with this name
+  const DrugModel* Find(const std::string& name) const {
+    auto it = models_.find(name);
+    return it == models_.end() ? nullptr : &it->second;
+  }
+
+  std::vector<std::string> GetNames() const {
+    std::vector<std::string> names;
+    for (auto& entry : models_) {
+      names.push_back(entry.first);
+    }
+    return names;
+  }
+
+ private:
+  std::map<std::string, DrugModel> models_;
+};
+
+struct DrugRegistration {
+  explicit DrugRegistration(const DrugModel& model) {
+    DrugRegistry::Get()->Register(model);
+  }
+};
+
+// Define my custom cell MyCell, which extends Cell by adding extra data
+// members: cell_color and can_divide
+class MyCell : public Cell {  // our object extends the Cell object
+                              // create the header with our new data member
+  BDM_SIM_OBJECT_HEADER(MyCell, Cell, 1,);
+
+ public:
+  MyCell() {}
+  explicit MyCell(const Double3& position) : Base(position) {}
+
+  /// If MyCell divides, daughter 2 copies the data members from the mother
+  MyCell(const Event& event, SimObject* other, uint64_t new_oid = 0)
+      : Base(event, other, new_oid) {
+  }
+
+  /// If a cell divides, daughter keeps the same state from its mother.
+  void EventHandler(const Event& event, SimObject* other1,
+                    SimObject* other2 = nullptr) override {
+    Base::EventHandler(event, other1, other2);
+  }
+};
+
+// Everything the biology module of a drug scenario needs
+struct DrugContext {
+  const DrugModel* model = nullptr;
+  FloatDiffusionGrid* grid = nullptr;
+  /// births, deaths and survivors
+  PopulationCounters* counters = nullptr;
+  /// fraction of the concentration at its position that a cell takes up per
+  /// hour (0: cells do not consume the drug)
+  double uptake_rate = 0;
+};
+
+/// What a cell does in one timestep
+enum class DrugResponse { kSurvive, kDivide, kDie };
+
+/// Dose response of a cell at `position`: draws whether it divides or dies,
+/// updates the counters and records the uptake of a surviving cell.
+/// Shared by ChemicalDrugBM and CompactPopulation (which draws from a
+/// CounterRandom of the cell).
+DrugResponse ApplyDrug(const DrugContext& context, const Double3& position,
+                       Random* random);
+DrugResponse ApplyDrug(const DrugContext& context, const Double3& position,
+                       CounterRandom* random);
+
+// Define Chemical Drug Biology Module
+struct ChemicalDrugBM : public BaseBiologyModule {
+ public:
+  ChemicalDrugBM() : BaseBiologyModule(gAllEventIds) {}
+  explicit ChemicalDrugBM(const DrugContext* context) : ChemicalDrugBM() {
+    context_ = context;
+  }
+
+  /// The daughter cell responds to the same drug.
+  ChemicalDrugBM(const Event& event, BaseBiologyModule* other,
+                 uint64_t new_oid = 0)
+      : ChemicalDrugBM(bdm_static_cast<ChemicalDrugBM*>(other)->context_) {}
+
+  BaseBiologyModule* GetInstance(const Event& event, BaseBiologyModule* other,
+                                 uint64_t new_oid = 0) const override {
+    return new ChemicalDrugBM(event, other, new_oid);
+  }
+
+  BaseBiologyModule* GetCopy() const override {
+    return new ChemicalDrugBM(*this);
+  }
+
+  void Run(SimObject* so) override;
+
+ private:
+  const DrugContext* context_ = nullptr;  //!
+  BDM_CLASS_DEF_OVERRIDE(ChemicalDrugBM, 1);
+};
+
+/// kBioDynaMo: cells are MyCells with mechanics (cells push each other).
+/// kCompact: cells are stored in a CompactPopulation, without mechanics.
+enum class DrugEngine { kBioDynaMo, kCompact };
+
+/// Parameters of the drug scenarios, read from the [scenario] section of
+/// bdm.toml or from the command line (see ScenarioOptions).
+struct DrugScenario {
+  /// names of the drugs that are simulated one after another
+  std::vector<std::string> drugs;
+  /// number of cells at the start of the simulation
+  uint64_t cell_count = 10000;
+  double cell_diameter = 7.5;
+  /// initial drug concentration in uM
+  double concentration = 500;
+  /// negative: use the diffusion coefficient of the drug model
+  double diffusion_coefficient = -1;
+  /// negative: use the decay constant of the drug model
+  double decay_constant = -1;
+  /// "euler" or "implicit"; use "implicit" for diffusion with large
+  /// timesteps (see DiffusionMethod)
+  DiffusionMethod diffusion_method = DiffusionMethod::kEuler;
+  /// timesteps (hours) after which the number of cells is printed; the
+  /// simulation ends with the last one
+  std::vector<int64_t> report_steps = {24, 72};
+  /// the cells are placed randomly in the cube [min_bound, max_bound]^3
+  double min_bound = -150;
+  double max_bound = 150;
+  /// fraction of the local concentration a cell takes up per hour
+  double uptake_rate = 0;
+  /// "biodynamo" or "compact" (see DrugEngine)
+  DrugEngine engine = DrugEngine::kBioDynaMo;
+  /// number of boxes of the diffusion grid along each axis
+  int resolution = 20;
+  /// seed of the random number generators (0: random_seed of bdm.toml)
+  uint64_t seed = 0;
+  /// directory of the result cache (empty: no cache)
+  std::string result_cache;
+  /// seconds between two reports of the live population counters while the
+  /// simulation runs; 0 disables them
+  double monitor_interval = 0;
+  /// end the simulation of a drug early, e.g. when all cells are dead
+  StopConditions stop;
+  /// false: nothing is written to stdout, only the DrugResult is returned
+  /// (e.g. for drivers that run many scenarios in one process)
+  bool print = true;
+  /// true: the DrugResult contains the final cell positions. Off by default,
+  /// sweeps only need the numbers of cells. The result cache stores no
+  /// positions, so these runs are never read from it.
+  bool keep_positions = false;
+
+  /// Reads and validates all parameters
+  static DrugScenario FromOptions(ScenarioOptions* options);
+};
+
+/// Result of the scenario of one drug
+struct DrugResult {
+  struct Report {
+    uint64_t step;
+    uint64_t cells;
+    uint64_t births;
+    uint64_t deaths;
+  };
+  /// why the simulation ended
+  StopReason stop_reason = StopReason::kCompleted;
+  /// number of cells at the start and after every timestep
+  std::vector<uint64_t> cells;
+  /// one entry per reached report step (and the last step if it stopped
+  /// early)
+  std::vector<Report> reports;
+  /// positions of the cells at the end (only with keep_positions)
+  std::vector<Double3> positions;
+  /// of this run; a cached result only has the total time (to load it)
+  RunTimings timings;
+  /// true if the result was read from the result cache
+  bool cached = false;
+};
+
+/// Runs the scenario of one drug, or reads its result from the result cache
+/// if the same scenario ran before with the same model code.
+/// `argc` and `argv` are passed to Simulation (name of the simulation,
+/// BioDynaMo options).
+DrugResult SimulateDrug(const DrugModel& model, const DrugScenario& scenario,
+                        int argc, const char** argv);
+
+/// Library entry point: runs the scenario of one drug without command line,
+/// e.g.
+///   DrugScenario scenario;
+///   scenario.print = false;
+///   auto result = SimulateDrug(*DrugRegistry::Get()->Find("docetaxel"),
+///                              scenario);
+/// (Find returns nullptr for a name that is not registered)
+DrugResult SimulateDrug(const DrugModel& model, const DrugScenario& scenario);
+
+/// Runs the drugs given with --drug=<name>[,<name>...] (or `drug` in the
+/// [scenario] section of bdm.toml) one after another.
+/// --trace writes a timeline of every drug to <output dir>/trace.json.
+int Simulate(int argc, const char** argv);
+
+}  // namespace bdm
+
+#endif  // DRUG_SIMULATION_H_
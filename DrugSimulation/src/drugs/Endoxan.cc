@@ -11,6 +11,24 @@
 // regarding copyright ownership.
 //
 // -----------------------------------------------------------------------------
-#include "Endoxan.h"
+#include <cmath>
 
-int main(int argc, const char** argv) { return bdm::Simulate(argc, argv); }
+#include "DrugSimulation.h"
+
+namespace bdm {
+namespace {
+
+// At high concentrations Endoxan kills cells, at low concentrations it
+// promotes their proliferation. Endoxan decays over time.
+double EndoxanProportion(double c) {
+  double C = log10(c + 0.043);
+  return 1 + (0.002 + 0.00103 * C - 0.00203 * C * C);
+}
+
+bool EndoxanProliferates(double c, double P) { return P > 1; }
+
+DrugRegistration kEndoxan(
+    {"Endoxan", 0, 0.05, 1, EndoxanProportion, EndoxanProliferates});
+
+}  // namespace
+}  // namespace bdm
@@ -11,6 +11,23 @@
 // regarding copyright ownership.
 //
 // -----------------------------------------------------------------------------
-#include "docetaxel.h"
+#include <cmath>
 
-int main(int argc, const char** argv) { return bdm::Simulate(argc, argv); }
+#include "DrugSimulation.h"
+
+namespace bdm {
+namespace {
+
+// 5-FU kills cells above 1.09 uM and promotes their proliferation below.
+// The initial concentration decreases by 1 percent along the z axis.
+double FiveFUProportion(double c) {
+  return pow(2.71828, (8.77735 * 0.0001 - 0.0025 * log(c + 0.32518)));
+}
+
+bool FiveFUProliferates(double c, double P) { return c <= 1.09; }
+
+DrugRegistration kFiveFU(
+    {"5-FU", 0, 0, 0.99, FiveFUProportion, FiveFUProliferates});
+
+}  // namespace
+}  // namespace bdm
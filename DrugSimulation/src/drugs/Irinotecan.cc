@@ -11,6 +11,23 @@
 // regarding copyright ownership.
 //
 // -----------------------------------------------------------------------------
-#include "Five_FU.h"
+#include <cmath>
 
-int main(int argc, const char** argv) { return bdm::Simulate(argc, argv); }
+#include "DrugSimulation.h"
+
+namespace bdm {
+namespace {
+
+// Irinotecan decays over time.
+double IrinotecanProportion(double c) {
+  double C = log10(c);
+  return 1 + (-0.00448 * C);
+}
+
+bool IrinotecanProliferates(double c, double P) { return P > 1; }
+
+DrugRegistration kIrinotecan(
+    {"Irinotecan", 0, 0.03, 1, IrinotecanProportion, IrinotecanProliferates});
+
+}  // namespace
+}  // namespace bdm
@@ -0,0 +1,35 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#include <cmath>
+
+#include "DrugSimulation.h"
+
+namespace bdm {
+namespace {
+
+// Docetaxel promotes proliferation between 6.5 and 8.5 uM and kills cells
+// at other concentrations. Docetaxel decays over time.
+double DocetaxelProportion(double c) {
+  return 1 - ((log(fabs(7.5 - c)) / 600) * ((c - 0.05) / c));
+}
+
+bool DocetaxelProliferates(double c, double P) {
+  return 6.5 < c && c < 8.5;
+}
+
+DrugRegistration kDocetaxel(
+    {"docetaxel", 0, 0.005, 1, DocetaxelProportion, DocetaxelProliferates});
+
+}  // namespace
+}  // namespace bdm
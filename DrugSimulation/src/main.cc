@@ -11,6 +11,6 @@
 // regarding copyright ownership.
 //
 // -----------------------------------------------------------------------------
-#include "Irinotecan.h"
+#include "DrugSimulation.h"
 
 int main(int argc, const char** argv) { return bdm::Simulate(argc, argv); }
@@ -0,0 +1,143 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+//
+// Checks of the diffusion solvers of FloatDiffusionGrid (run with ctest):
+//  - for a small r = dc * dt / box_length^2 the implicit (LOD / Thomas)
+//    solution agrees with the explicit Euler solution
+//  - without decay both solvers conserve the mass (Euler to 1e-6, the
+//    implicit one to 1e-5), the implicit one also for hour-sized timesteps
+//    far beyond the stability limit of Euler
+//  - with dc = 0 only the decay is applied
+// Returns 1 if a check fails.
+
+#include <cmath>
+#include <cstdio>
+
+#include "float_diffusion_grid.h"
+
+using namespace bdm;
+
+namespace {
+
+const int kResolution = 24;
+const double kMinBound = 0;
+const double kMaxBound = 240;  // box length 10
+
+/// Off-center Gaussian blob, so the closed edges matter
+void InitBlob(FloatDiffusionGrid* grid) {
+  grid->Initialize(kMinBound, kMaxBound);
+  grid->RunInitializer([](double x, double y, double z) {
+    double dx = x - 90, dy = y - 130, dz = z - 110;
+    return 100 * std::exp(-(dx * dx + dy * dy + dz * dz) / (2 * 30 * 30));
+  });
+}
+
+double Mass(const FloatDiffusionGrid& grid) {
+  double mass = 0;
+  for (size_t i = 0; i < grid.GetNumBoxes(); i++) {
+    mass += grid.GetAllConcentrations()[i];
+  }
+  return mass;
+}
+
+int failures = 0;
+
+void Expect(bool condition, const char* check, double value, double limit) {
+  std::printf("%-50s %12.3e (limit %.1e) %s\n", check, value, limit,
+              condition ? "ok" : "FAILED");
+  if (!condition) {
+    failures++;
+  }
+}
+
+/// Largest difference between the implicit and the Euler solution after the
+/// same time (100), relative to the largest initial concentration.
+/// r = 1 * dt / 10^2
+double ImplicitVsEuler(double dt) {
+  FloatDiffusionGrid euler("euler", 1, 0.001, kResolution);
+  FloatDiffusionGrid implicit("implicit", 1, 0.001, kResolution);
+  InitBlob(&euler);
+  InitBlob(&implicit);
+  implicit.SetDiffusionMethod(DiffusionMethod::kImplicit);
+  double max_concentration = 0;
+  for (size_t i = 0; i < euler.GetNumBoxes(); i++) {
+    max_concentration =
+        std::max(max_concentration, double(euler.GetAllConcentrations()[i]));
+  }
+  const int steps = static_cast<int>(std::lround(100 / dt));
+  for (int step = 0; step < steps; step++) {
+    euler.Diffuse(dt);
+    implicit.Diffuse(dt);
+  }
+  double max_difference = 0;
+  for (size_t i = 0; i < euler.GetNumBoxes(); i++) {
+    max_difference = std::max(
+        max_difference, std::abs(double(euler.GetAllConcentrations()[i]) -
+                                 implicit.GetAllConcentrations()[i]));
+  }
+  return max_difference / max_concentration;
+}
+
+/// Both methods are first order in time, so the difference must be small
+/// for a small r and halve with r.
+void ImplicitMatchesEuler() {
+  double difference = ImplicitVsEuler(1);
+  double half = ImplicitVsEuler(0.5);
+  Expect(difference < 2e-3, "implicit vs euler, r = 0.01", difference, 2e-3);
+  Expect(std::abs(difference / half - 2) < 0.4,
+         "implicit vs euler, r = 0.01 / r = 0.005", difference / half, 2);
+}
+
+/// The concentrations are floats, and the implicit solver accumulates more
+/// rounding errors (three tridiagonal solves per step) than Euler
+void MassConservation(DiffusionMethod method, double dc, double limit,
+                      const char* check) {
+  FloatDiffusionGrid grid("mass", dc, 0, kResolution);
+  InitBlob(&grid);
+  grid.SetDiffusionMethod(method);
+  double mass = Mass(grid);
+  for (int step = 0; step < 72; step++) {
+    grid.Diffuse(1);
+  }
+  double relative = std::abs(Mass(grid) - mass) / mass;
+  Expect(relative < limit, check, relative, limit);
+}
+
+void DecayOnly(DiffusionMethod method, double expected_factor,
+               const char* check) {
+  FloatDiffusionGrid grid("decay", 0, 0.05, kResolution);
+  grid.Initialize(kMinBound, kMaxBound);
+  grid.SetDiffusionMethod(method);
+  grid.Fill(100);
+  grid.Diffuse(1);
+  double error = std::abs(grid.GetAllConcentrations()[0] / 100 - expected_factor);
+  Expect(error < 1e-6, check, error, 1e-6);
+}
+
+}  // namespace
+
+int main() {
+  ImplicitMatchesEuler();
+  MassConservation(DiffusionMethod::kEuler, 10, 1e-6,
+                   "mass without decay, euler, r = 0.1");
+  MassConservation(DiffusionMethod::kImplicit, 10, 1e-5,
+                   "mass without decay, implicit, r = 0.1");
+  // far beyond the stability limit r < 1/6 of Euler
+  MassConservation(DiffusionMethod::kImplicit, 5000, 1e-5,
+                   "mass without decay, implicit, r = 50");
+  DecayOnly(DiffusionMethod::kEuler, 0.95, "decay only, euler: 1 - mu");
+  DecayOnly(DiffusionMethod::kImplicit, 1 / 1.05,
+            "decay only, implicit: 1 / (1 + mu)");
+  return failures == 0 ? 0 : 1;
+}
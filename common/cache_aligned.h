@@ -0,0 +1,104 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#ifndef COMMON_CACHE_ALIGNED_H_
+#define COMMON_CACHE_ALIGNED_H_
+
+#include <stdlib.h>
+#include <cstddef>
+#include <new>
+
+#include "biodynamo.h"
+
+namespace bdm {
+
+constexpr size_t kCacheLineSize = 64;
+
+/// `T` aligned to a cache line and padded to a multiple of it, so two
+/// CacheAligned objects never share a cache line
+template <typename T>
+struct alignas(kCacheLineSize) CacheAligned {
+  T value;
+};
+
+// Array of cache-aligned elements, e.g. one accumulator per thread that is
+// written in a parallel loop (no false sharing between the threads).
+// std::vector does not align its elements to a cache line before C++17, so
+// the memory is allocated with posix_memalign.
+template <typename T>
+class CacheAlignedArray {
+ public:
+  CacheAlignedArray() {}
+  explicit CacheAlignedArray(size_t size) { Assign(size); }
+  CacheAlignedArray(size_t size, const T& value) { Assign(size, value); }
+
+  ~CacheAlignedArray() { Clear(); }
+
+  CacheAlignedArray(const CacheAlignedArray&) = delete;
+  CacheAlignedArray& operator=(const CacheAlignedArray&) = delete;
+
+  /// Replaces the content by `size` value-initialized elements (also for
+  /// types that cannot be copied, e.g. atomics)
+  void Assign(size_t size) {
+    Allocate(size);
+    for (size_t i = 0; i < size; i++) {
+      new (&data_[i]) CacheAligned<T>();
+    }
+    size_ = size;
+  }
+
+  /// Replaces the content by `size` copies of `value`
+  void Assign(size_t size, const T& value) {
+    Allocate(size);
+    for (size_t i = 0; i < size; i++) {
+      new (&data_[i]) CacheAligned<T>{value};
+    }
+    size_ = size;
+  }
+
+  void Clear() {
+    for (size_t i = 0; i < size_; i++) {
+      data_[i].~CacheAligned<T>();
+    }
+    free(data_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  size_t size() const { return size_; }
+
+  T& operator[](size_t i) { return data_[i].value; }
+  const T& operator[](size_t i) const { return data_[i].value; }
+
+ private:
+  CacheAligned<T>* data_ = nullptr;
+  size_t size_ = 0;
+
+  void Allocate(size_t size) {
+    Clear();
+    if (size == 0) {
+      return;
+    }
+    void* memory = nullptr;
+    if (posix_memalign(&memory, kCacheLineSize,
+                       size * sizeof(CacheAligned<T>)) != 0) {
+      Log::Fatal("CacheAlignedArray::Assign", "Could not allocate ", size,
+                 " elements");
+    }
+    data_ = static_cast<CacheAligned<T>*>(memory);
+  }
+};
+
+}  // namespace bdm
+
+#endif  // COMMON_CACHE_ALIGNED_H_
@@ -0,0 +1,48 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#ifndef COMMON_COMMAND_LINE_H_
+#define COMMON_COMMAND_LINE_H_
+
+#include <string>
+
+namespace bdm {
+
+/// Removes `--<name>` or `--<name>=<value>` from the command line arguments.
+/// The remaining arguments can be passed to Simulation, which does not know
+/// the options of the projects.
+/// Returns true if the option was given; `value` is set to the text after
+/// '=' (empty for `--<name>`).
+inline bool ExtractOption(const std::string& name, int* argc,
+                          const char** argv, std::string* value = nullptr) {
+  const std::string flag = "--" + name;
+  bool found = false;
+  int out = 1;
+  for (int i = 1; i < *argc; i++) {
+    std::string arg = argv[i];
+    if (arg == flag || arg.compare(0, flag.size() + 1, flag + "=") == 0) {
+      found = true;
+      if (value != nullptr) {
+        *value = arg.size() > flag.size() ? arg.substr(flag.size() + 1) : "";
+      }
+    } else {
+      argv[out++] = argv[i];
+    }
+  }
+  *argc = out;
+  return found;
+}
+
+}  // namespace bdm
+
+#endif  // COMMON_COMMAND_LINE_H_
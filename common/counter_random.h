@@ -0,0 +1,63 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#ifndef COMMON_COUNTER_RANDOM_H_
+#define COMMON_COUNTER_RANDOM_H_
+
+#include <cstdint>
+#include <cstring>
+
+namespace bdm {
+
+// Counter-based random numbers: the numbers of an item (e.g. a cell in one
+// timestep) are hashes of a key made of the seed, the timestep and the item.
+// There is no generator state to share between threads, so the result does
+// not depend on the number of threads or on which thread runs the item.
+//
+//   const uint64_t step_key = CounterRandom::Mix(seed ^ step);
+//   CounterRandom random(CounterRandom::Mix(step_key ^ cell));
+//   double u = random.Uniform(0, 1);
+class CounterRandom {
+ public:
+  explicit CounterRandom(uint64_t key) : counter_(key) {}
+
+  /// [min, max)
+  double Uniform(double min, double max) {
+    return min + (max - min) * ToUniform(Mix(counter_++));
+  }
+
+  /// Finalizer of splitmix64
+  static uint64_t Mix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+  }
+
+  /// [0, 1) from the upper 52 bits: they are the mantissa of a double in
+  /// [1, 2). Unlike a conversion of the integer (which needs AVX-512DQ to
+  /// vectorize), these are bit operations and a subtraction.
+  static double ToUniform(uint64_t bits) {
+    const uint64_t one_to_two = (bits >> 12) | 0x3ff0000000000000ull;
+    double value;
+    memcpy(&value, &one_to_two, sizeof(double));
+    return value - 1;
+  }
+
+ private:
+  uint64_t counter_;
+};
+
+}  // namespace bdm
+
+#endif  // COMMON_COUNTER_RANDOM_H_
@@ -0,0 +1,505 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#ifndef COMMON_FLOAT_DIFFUSION_GRID_H_
+#define COMMON_FLOAT_DIFFUSION_GRID_H_
+
+#include <omp.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "biodynamo.h"
+#include "cache_aligned.h"
+#include "core/substance_initializers.h"
+
+namespace bdm {
+
+/// kEuler: explicit Euler, stable only if dc * dt / box_length^2 < 1/6.
+/// kImplicit: locally one-dimensional implicit Euler (one tridiagonal solve
+/// per grid line and axis), stable for every timestep, e.g. one hour.
+enum class DiffusionMethod { kEuler, kImplicit };
+
+/// Diffusion grid that stores concentrations in single precision.
+///
+/// The dose-response fits of the drug projects need at most three significant
+/// digits, so storing the concentrations as float halves the memory and the
+/// bandwidth of the grid compared to DiffusionGrid.
+/// Gradients are not updated every timestep. They are computed on demand,
+/// e.g. only for the timesteps that are exported.
+///
+/// The grid covers the cube [min_bound, max_bound]^3 with `resolution` boxes
+/// along each axis. Edges are closed (no flux leaves the simulation space).
+class FloatDiffusionGrid {
+ public:
+  /// Order: substance_name, diffusion_coefficient, decay_constant, resolution
+  /// (same order as ModelInitializer::DefineSubstance)
+  FloatDiffusionGrid(const std::string& substance_name, double dc, double mu,
+                     int resolution)
+      : substance_name_(substance_name),
+        dc_(dc),
+        mu_(mu),
+        resolution_(resolution) {}
+
+  /// Allocates the grid for the cube [min_bound, max_bound]^3.
+  void Initialize(double min_bound, double max_bound) {
+    if (resolution_ < 1 || max_bound <= min_bound) {
+      Log::Fatal("FloatDiffusionGrid::Initialize",
+                 "Invalid resolution or bounds for substance ",
+                 substance_name_);
+    }
+    min_bound_ = min_bound;
+    box_length_ = (max_bound - min_bound) / resolution_;
+    num_boxes_ = static_cast<size_t>(resolution_) * resolution_ * resolution_;
+    c1_.assign(num_boxes_, 0.f);
+    c2_.assign(num_boxes_, 0.f);
+    gradients_.clear();
+    uptake_.Clear();
+  }
+
+  /// Allocates one uptake list per thread for Uptake(). Call after
+  /// Initialize().
+  void EnableUptake() { uptake_.Assign(omp_get_max_threads()); }
+
+  /// Removes `amount` from the box at `position` at the end of the timestep
+  /// (see MergeUptake). Safe to call from the biology modules in parallel:
+  /// every thread appends to its own list, without atomics. The amounts
+  /// are stored in fixed point, so the merged result does not depend on
+  /// which thread processed which cell.
+  void Uptake(const Double3& position, double amount) {
+    const size_t thread = omp_get_thread_num();
+    if (thread >= uptake_.size()) {
+      Log::Fatal("FloatDiffusionGrid::Uptake", "Thread ", thread,
+                 " started after EnableUptake()");
+    }
+    auto& entries = uptake_[thread];
+    const uint64_t box = GetBoxIndex(position);
+    const int64_t fixed = static_cast<int64_t>(std::llround(amount * kUptakeScale));
+    // neighboring cells are often in the same box
+    if (!entries.empty() && entries.back().box == box) {
+      entries.back().amount += fixed;
+    } else {
+      entries.push_back({box, fixed});
+    }
+  }
+
+  /// Subtracts the uptake of all threads from the concentrations (never below
+  /// zero) and clears the lists. Call once per timestep, after the biology
+  /// modules ran.
+  ///
+  /// Every list is sorted by box, then every thread merges the entries of a
+  /// range of boxes from all lists, so each box is updated by one thread
+  /// and the lists need memory per cell, not per box and thread.
+  void MergeUptake() {
+    const int num_lists = static_cast<int>(uptake_.size());
+    bool empty = true;
+    for (int t = 0; t < num_lists; t++) {
+      empty = empty && uptake_[t].empty();
+    }
+    if (empty) {
+      return;
+    }
+#pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < num_lists; t++) {
+      auto& entries = uptake_[t];
+      std::sort(entries.begin(), entries.end(),
+                [](const UptakeEntry& a, const UptakeEntry& b) {
+                  return a.box < b.box;
+                });
+    }
+
+    float* c = c1_.data();
+#pragma omp parallel
+    {
+      const uint64_t num_threads = omp_get_num_threads();
+      const uint64_t self = omp_get_thread_num();
+      const uint64_t begin = num_boxes_ * self / num_threads;
+      const uint64_t end = num_boxes_ * (self + 1) / num_threads;
+      auto by_box = [](const UptakeEntry& e, uint64_t box) {
+        return e.box < box;
+      };
+      // k-way merge of the entries in [begin, end) of all lists
+      std::vector<const UptakeEntry*> cursors(num_lists);
+      std::vector<const UptakeEntry*> ends(num_lists);
+      std::priority_queue<std::pair<uint64_t, int>,
+                          std::vector<std::pair<uint64_t, int>>,
+                          std::greater<std::pair<uint64_t, int>>>
+          next;
+      for (int t = 0; t < num_lists; t++) {
+        const UptakeEntry* first = uptake_[t].data();
+        const UptakeEntry* last = first + uptake_[t].size();
+        cursors[t] = std::lower_bound(first, last, begin, by_box);
+        ends[t] = std::lower_bound(cursors[t], last, end, by_box);
+        if (cursors[t] != ends[t]) {
+          next.push({cursors[t]->box, t});
+        }
+      }
+      while (!next.empty()) {
+        const uint64_t box = next.top().first;
+        int64_t total = 0;
+        while (!next.empty() && next.top().first == box) {
+          const int t = next.top().second;
+          next.pop();
+          for (; cursors[t] != ends[t] && cursors[t]->box == box; cursors[t]++) {
+            total += cursors[t]->amount;
+          }
+          if (cursors[t] != ends[t]) {
+            next.push({cursors[t]->box, t});
+          }
+        }
+        if (total != 0) {
+          c[box] = std::max(0.f, c[box] - static_cast<float>(total / kUptakeScale));
+        }
+      }
+    }
+    for (int t = 0; t < num_lists; t++) {
+      uptake_[t].clear();
+    }
+  }
+
+  /// Sets the concentration of every box to `function(x, y, z)`, evaluated at
+  /// the lower corner of the box (same convention as DiffusionGrid).
+  /// The z-y planes are filled in parallel.
+  template <typename F>
+  void RunInitializer(F function) {
+    const int n = resolution_;
+#pragma omp parallel for collapse(2)
+    for (int z = 0; z < n; z++) {
+      for (int y = 0; y < n; y++) {
+        const double real_y = min_bound_ + y * box_length_;
+        const double real_z = min_bound_ + z * box_length_;
+        float* row = &c1_[Index(0, y, z)];
+        for (int x = 0; x < n; x++) {
+          double real_x = min_bound_ + x * box_length_;
+          row[x] = static_cast<float>(function(real_x, real_y, real_z));
+        }
+      }
+    }
+  }
+
+  /// Initializer for concentrations that only change along the axis kAxis.
+  /// `profile(coordinate)` is evaluated once per box along kAxis, not once
+  /// per box, and the grid is filled with plain stores (rows for kXAxis,
+  /// constant rows for kYAxis, constant planes for kZAxis).
+  template <Axis kAxis, typename F>
+  void RunAxisInitializer(F profile) {
+    const int n = resolution_;
+    std::vector<float> values(n);
+    for (int i = 0; i < n; i++) {
+      values[i] = static_cast<float>(profile(min_bound_ + i * box_length_));
+    }
+    const float* v = values.data();
+#pragma omp parallel for collapse(2)
+    for (int z = 0; z < n; z++) {
+      for (int y = 0; y < n; y++) {
+        float* row = &c1_[Index(0, y, z)];
+        if (kAxis == Axis::kXAxis) {
+          std::copy(v, v + n, row);
+        } else {
+          std::fill(row, row + n, v[kAxis == Axis::kYAxis ? y : z]);
+        }
+      }
+    }
+  }
+
+  /// Sets every box to the same concentration
+  void Fill(float value) {
+    const size_t num_boxes = num_boxes_;
+    float* c = c1_.data();
+#pragma omp parallel for simd
+    for (size_t i = 0; i < num_boxes; i++) {
+      c[i] = value;
+    }
+  }
+
+  void SetDiffusionMethod(DiffusionMethod method) { method_ = method; }
+
+  /// Advances the concentrations by `dt` with the selected DiffusionMethod.
+  /// Edges are closed in both methods.
+  void Diffuse(double dt) {
+    if (method_ == DiffusionMethod::kImplicit) {
+      DiffuseImplicit(dt);
+    } else {
+      DiffuseEuler(dt);
+    }
+  }
+
+  /// Explicit Euler update with closed edges, i.e. the same scheme as
+  /// DiffusionGrid::DiffuseEuler. With a diffusion coefficient of 0 only the
+  /// decay is applied.
+  void DiffuseEuler(double dt) {
+    const float decay = static_cast<float>(1 - mu_ * dt);
+    if (dc_ == 0) {
+      const size_t num_boxes = num_boxes_;
+      float* c = c1_.data();
+#pragma omp parallel for simd
+      for (size_t i = 0; i < num_boxes; i++) {
+        c[i] *= decay;
+      }
+      return;
+    }
+
+    const int n = resolution_;
+    const float d =
+        static_cast<float>(dc_ * dt / (box_length_ * box_length_));
+#pragma omp parallel for
+    for (int z = 0; z < n; z++) {
+      const int zm = std::max(z - 1, 0);
+      const int zp = std::min(z + 1, n - 1);
+      for (int y = 0; y < n; y++) {
+        const int ym = std::max(y - 1, 0);
+        const int yp = std::min(y + 1, n - 1);
+        for (int x = 0; x < n; x++) {
+          const int xm = std::max(x - 1, 0);
+          const int xp = std::min(x + 1, n - 1);
+          const float c = c1_[Index(x, y, z)];
+          const float neighbors = c1_[Index(xm, y, z)] + c1_[Index(xp, y, z)] +
+                                  c1_[Index(x, ym, z)] + c1_[Index(x, yp, z)] +
+                                  c1_[Index(x, y, zm)] + c1_[Index(x, y, zp)];
+          c2_[Index(x, y, z)] = c * decay + d * (neighbors - 6 * c);
+        }
+      }
+    }
+    c1_.swap(c2_);
+  }
+
+  /// Implicit update with operator splitting: backward Euler along x, then
+  /// along y, then along z, each a tridiagonal system per grid line that is
+  /// solved with the Thomas algorithm. The decay is implicit as well, so the
+  /// update is stable for any dt and conserves the mass without decay.
+  ///
+  /// All lines have the same matrix, so the elimination factors are computed
+  /// once per call. The x lines are contiguous rows; the y and z sweeps solve
+  /// all lines of a block of x values together, so the innermost loop runs
+  /// over contiguous memory and vectorizes.
+  void DiffuseImplicit(double dt) {
+    const int n = resolution_;
+    if (dc_ != 0 && n > 1) {
+      const double r = dc_ * dt / (box_length_ * box_length_);
+      // m[i]: inverse pivot, cp[i]: modified upper diagonal
+      // diagonal 1 + 2r (1 + r at the closed edges), off-diagonals -r
+      std::vector<float> m(n);
+      std::vector<float> cp(n);
+      double prev_cp = 0;
+      for (int i = 0; i < n; i++) {
+        double b = (i == 0 || i == n - 1) ? 1 + r : 1 + 2 * r;
+        double inv = 1 / (b + r * prev_cp);
+        m[i] = static_cast<float>(inv);
+        prev_cp = i == n - 1 ? 0 : -r * inv;
+        cp[i] = static_cast<float>(prev_cp);
+      }
+      const float rf = static_cast<float>(r);
+      SweepX(m.data(), cp.data(), rf);
+      const size_t plane = static_cast<size_t>(n) * n;
+      SweepStrided(m.data(), cp.data(), rf, n, plane);  // y lines
+      SweepStrided(m.data(), cp.data(), rf, plane, n);  // z lines
+    }
+    if (mu_ != 0) {
+      const float decay = static_cast<float>(1 / (1 + mu_ * dt));
+      const size_t num_boxes = num_boxes_;
+      float* c = c1_.data();
+#pragma omp parallel for simd
+      for (size_t i = 0; i < num_boxes; i++) {
+        c[i] *= decay;
+      }
+    }
+  }
+
+  /// Computes the gradient of every box with central differences.
+  /// Call this only when the gradient is needed (e.g. before an export).
+  void CalculateGradient() {
+    const int n = resolution_;
+    gradients_.resize(3 * num_boxes_);
+    const float inv = static_cast<float>(1 / (2 * box_length_));
+#pragma omp parallel for
+    for (int z = 0; z < n; z++) {
+      const int zm = std::max(z - 1, 0);
+      const int zp = std::min(z + 1, n - 1);
+      for (int y = 0; y < n; y++) {
+        const int ym = std::max(y - 1, 0);
+        const int yp = std::min(y + 1, n - 1);
+        for (int x = 0; x < n; x++) {
+          const int xm = std::max(x - 1, 0);
+          const int xp = std::min(x + 1, n - 1);
+          const size_t idx = Index(x, y, z);
+          gradients_[3 * idx] = (c1_[Index(xp, y, z)] - c1_[Index(xm, y, z)]) * inv;
+          gradients_[3 * idx + 1] = (c1_[Index(x, yp, z)] - c1_[Index(x, ym, z)]) * inv;
+          gradients_[3 * idx + 2] = (c1_[Index(x, y, zp)] - c1_[Index(x, y, zm)]) * inv;
+        }
+      }
+    }
+  }
+
+  /// Writes concentration and gradient as legacy VTK structured points,
+  /// which can be opened in ParaView. The gradient is computed here.
+  void ExportVtk(const std::string& filename) {
+    CalculateGradient();
+    std::ofstream ofs(filename);
+    if (!ofs) {
+      Log::Warning("FloatDiffusionGrid::ExportVtk", "Could not open ",
+                   filename);
+      return;
+    }
+    const int n = resolution_;
+    ofs << "# vtk DataFile Version 3.0\n"
+        << substance_name_ << "\n"
+        << "ASCII\n"
+        << "DATASET STRUCTURED_POINTS\n"
+        << "DIMENSIONS " << n << " " << n << " " << n << "\n"
+        << "ORIGIN " << min_bound_ << " " << min_bound_ << " " << min_bound_
+        << "\n"
+        << "SPACING " << box_length_ << " " << box_length_ << " "
+        << box_length_ << "\n"
+        << "POINT_DATA " << num_boxes_ << "\n"
+        << "SCALARS Substance_Concentration float 1\n"
+        << "LOOKUP_TABLE default\n";
+    for (size_t i = 0; i < num_boxes_; i++) {
+      ofs << c1_[i] << "\n";
+    }
+    ofs << "VECTORS Diffusion_Gradient float\n";
+    for (size_t i = 0; i < num_boxes_; i++) {
+      ofs << gradients_[3 * i] << " " << gradients_[3 * i + 1] << " "
+          << gradients_[3 * i + 2] << "\n";
+    }
+  }
+
+  size_t GetBoxIndex(const Double3& position) const {
+    return Index(BoxCoordinate(position[0]), BoxCoordinate(position[1]),
+                 BoxCoordinate(position[2]));
+  }
+
+  float GetConcentration(const Double3& position) const {
+    return c1_[GetBoxIndex(position)];
+  }
+
+  const float* GetAllConcentrations() const { return c1_.data(); }
+
+  /// Only valid after CalculateGradient() or ExportVtk()
+  const float* GetAllGradients() const { return gradients_.data(); }
+
+  const std::string& GetSubstanceName() const { return substance_name_; }
+  double GetDiffusionCoefficient() const { return dc_; }
+  double GetDecayConstant() const { return mu_; }
+  int GetResolution() const { return resolution_; }
+  double GetBoxLength() const { return box_length_; }
+  size_t GetNumBoxes() const { return num_boxes_; }
+
+ private:
+  std::string substance_name_;
+  double dc_;
+  double mu_;
+  int resolution_;
+  double min_bound_ = 0;
+  double box_length_ = 1;
+  size_t num_boxes_ = 0;
+  /// concentrations of the current timestep
+  std::vector<float> c1_;
+  /// scratch buffer for the explicit update (the implicit update works in
+  /// place)
+  std::vector<float> c2_;
+  /// x, y, z components of the gradient of every box
+  std::vector<float> gradients_;
+  DiffusionMethod method_ = DiffusionMethod::kEuler;
+  /// amount taken up from `box` in units of 1 / kUptakeScale
+  struct UptakeEntry {
+    uint64_t box;
+    int64_t amount;
+  };
+  /// uptake of the current timestep, one list per thread
+  CacheAlignedArray<std::vector<UptakeEntry>> uptake_;
+  static constexpr double kUptakeScale = 1 << 24;
+
+  /// Number of x values whose lines are solved together in the y and z
+  /// sweeps (a block of 256 floats per line fits in L1 with its neighbors).
+  static constexpr int kSweepBlock = 256;
+
+  /// Thomas algorithm in place along every row (x lines)
+  void SweepX(const float* m, const float* cp, float r) {
+    const int n = resolution_;
+#pragma omp parallel for collapse(2)
+    for (int z = 0; z < n; z++) {
+      for (int y = 0; y < n; y++) {
+        float* line = &c1_[Index(0, y, z)];
+        line[0] *= m[0];
+        for (int i = 1; i < n; i++) {
+          line[i] = (line[i] + r * line[i - 1]) * m[i];
+        }
+        for (int i = n - 2; i >= 0; i--) {
+          line[i] -= cp[i] * line[i + 1];
+        }
+      }
+    }
+  }
+
+  /// Thomas algorithm in place along the y lines (stride n, outer stride
+  /// n * n) or the z lines (stride n * n, outer stride n)
+  void SweepStrided(const float* m, const float* cp, float r, size_t stride,
+                    size_t outer_stride) {
+    const int n = resolution_;
+    const int num_blocks = (n + kSweepBlock - 1) / kSweepBlock;
+#pragma omp parallel for collapse(2)
+    for (int o = 0; o < n; o++) {
+      for (int b = 0; b < num_blocks; b++) {
+        const int x0 = b * kSweepBlock;
+        // not std::min, which would bind kSweepBlock to a reference and
+        // need a definition of it (C++14)
+        const int len = n - x0 < kSweepBlock ? n - x0 : kSweepBlock;
+        float* base = c1_.data() + o * outer_stride + x0;
+        {
+          float* cur = base;
+#pragma omp simd
+          for (int x = 0; x < len; x++) {
+            cur[x] *= m[0];
+          }
+        }
+        for (int i = 1; i < n; i++) {
+          float* cur = base + i * stride;
+          const float* prev = cur - stride;
+          const float mi = m[i];
+#pragma omp simd
+          for (int x = 0; x < len; x++) {
+            cur[x] = (cur[x] + r * prev[x]) * mi;
+          }
+        }
+        for (int i = n - 2; i >= 0; i--) {
+          float* cur = base + i * stride;
+          const float* next = cur + stride;
+          const float ci = cp[i];
+#pragma omp simd
+          for (int x = 0; x < len; x++) {
+            cur[x] -= ci * next[x];
+          }
+        }
+      }
+    }
+  }
+
+  size_t Index(int x, int y, int z) const {
+    return (static_cast<size_t>(z) * resolution_ + y) * resolution_ + x;
+  }
+
+  int BoxCoordinate(double pos) const {
+    int coord = static_cast<int>(std::floor((pos - min_bound_) / box_length_));
+    return std::min(std::max(coord, 0), resolution_ - 1);
+  }
+};
+
+}  // namespace bdm
+
+#endif  // COMMON_FLOAT_DIFFUSION_GRID_H_
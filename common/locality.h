@@ -0,0 +1,172 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#ifndef COMMON_LOCALITY_H_
+#define COMMON_LOCALITY_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+
+#include "biodynamo.h"
+
+namespace bdm {
+
+// Reorders the cells in memory along a space filling curve when their
+// memory order no longer follows their position.
+//
+// Daughter cells are appended to the storage, so after a few hundred
+// divisions cells that are neighbors in space are far apart in memory.
+// ResourceManager::SortAndBalanceNumaNodes() sorts them along the Morton
+// order of the neighbor grid (and keeps the uid to index map up to date);
+// this class decides when that pays off.
+//
+// Locality is measured as the mean distance between cells that are next to
+// each other in memory, sampled at kSamples pairs. Every `check_interval`
+// timesteps it is compared to its value right after the last reordering;
+// once it is `threshold` times larger the cells are reordered again.
+//
+// The time per cell and timestep of the timesteps before a reordering and of
+// the same number of timesteps after it is reported (see GetReport), so the
+// effect can be measured in every run. It is normalized by the number of
+// cells because the population usually grows in the meantime; this assumes
+// that a timestep costs about the same per cell.
+class LocalityMonitor {
+ public:
+  struct Report {
+    uint64_t step = 0;
+    uint64_t num_cells = 0;
+    /// mean distance between cells that are next to each other in memory
+    double locality_before = 0;
+    double locality_after = 0;
+    /// wall-clock time of the timesteps divided by the number of cells
+    /// they simulated (sum over the timesteps), in seconds
+    double cell_time_before = 0;
+    double cell_time_after = 0;
+
+    void Print() const {
+      std::cout << "Reordered " << num_cells << " cells after " << step
+                << " timesteps (mean distance to the next cell in memory: "
+                << locality_before << " -> " << locality_after
+                << "), mean time per cell and timestep: "
+                << cell_time_before * 1e6 << " us before, "
+                << cell_time_after * 1e6 << " us after" << std::endl;
+    }
+  };
+
+  /// Below this number of cells the storage fits in the cache anyway
+  static constexpr uint64_t kMinCells = 1000;
+  /// Number of pairs of cells of MeanNeighborDistance
+  static constexpr uint64_t kSamples = 10000;
+
+  /// check_interval 0 disables the reordering
+  LocalityMonitor(uint64_t check_interval, double threshold)
+      : check_interval_(check_interval), threshold_(threshold) {}
+
+  /// Call after every timestep with its wall-clock time.
+  /// Returns true if a report is complete, i.e. `check_interval` timesteps
+  /// after a reordering.
+  bool Update(uint64_t step, ResourceManager* rm, double step_seconds) {
+    if (check_interval_ == 0) {
+      return false;
+    }
+    step_time_ += step_seconds;
+    cell_steps_ += rm->GetNumSimObjects();
+    // at fixed timesteps, so a resumed run checks at the same timesteps
+    if (step % check_interval_ != 0) {
+      return false;
+    }
+    double cell_time = step_time_ / std::max<uint64_t>(cell_steps_, 1);
+    step_time_ = 0;
+    cell_steps_ = 0;
+
+    bool report_complete = false;
+    if (pending_) {
+      report_.cell_time_after = cell_time;
+      pending_ = false;
+      report_complete = true;
+    }
+
+    if (rm->GetNumSimObjects() < kMinCells) {
+      return report_complete;
+    }
+    double locality = MeanNeighborDistance(rm);
+    if (baseline_ == 0 || locality > threshold_ * baseline_) {
+      rm->SortAndBalanceNumaNodes();
+      baseline_ = MeanNeighborDistance(rm);
+      num_sorts_++;
+      report_ = Report();
+      report_.step = step;
+      report_.num_cells = rm->GetNumSimObjects();
+      report_.locality_before = locality;
+      report_.locality_after = baseline_;
+      report_.cell_time_before = cell_time;
+      pending_ = true;
+    }
+    return report_complete;
+  }
+
+  const Report& GetReport() const { return report_; }
+  uint64_t GetNumSorts() const { return num_sorts_; }
+
+  /// Locality right after the last reordering (0 before the first one).
+  /// It decides when the cells are reordered next, so checkpoints store it.
+  double GetBaseline() const { return baseline_; }
+  void SetBaseline(double baseline) { baseline_ = baseline; }
+
+  /// Mean distance between cells that are next to each other in memory.
+  /// Estimated from the pairs of cells (i, i + 1) for every `stride`-th
+  /// index i, at most about kSamples pairs spread over the whole memory;
+  /// the other cells are skipped without reading them.
+  static double MeanNeighborDistance(ResourceManager* rm) {
+    const uint64_t stride =
+        std::max<uint64_t>(2, rm->GetNumSimObjects() / kSamples);
+    double sum = 0;
+    uint64_t count = 0;
+    uint64_t index = 0;
+    Double3 previous;
+    rm->ApplyOnAllElements([&](SimObject* so) {
+      const uint64_t offset = index++ % stride;
+      if (offset == 0) {
+        previous = so->GetPosition();
+      } else if (offset == 1) {
+        const auto& position = so->GetPosition();
+        double dx = position[0] - previous[0];
+        double dy = position[1] - previous[1];
+        double dz = position[2] - previous[2];
+        sum += std::sqrt(dx * dx + dy * dy + dz * dz);
+        count++;
+      }
+    });
+    return count == 0 ? 0 : sum / count;
+  }
+
+ private:
+  uint64_t check_interval_;
+  double threshold_;
+  /// locality right after the last reordering
+  double baseline_ = 0;
+  uint64_t num_sorts_ = 0;
+  /// total time of the timesteps since the last check, and the sum of their
+  /// numbers of cells
+  double step_time_ = 0;
+  uint64_t cell_steps_ = 0;
+  /// true until the step time after the last reordering is known
+  bool pending_ = false;
+  Report report_;
+};
+
+}  // namespace bdm
+
+#endif  // COMMON_LOCALITY_H_
@@ -0,0 +1,148 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#ifndef COMMON_POPULATION_COUNTERS_H_
+#define COMMON_POPULATION_COUNTERS_H_
+
+#include <omp.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "biodynamo.h"
+#include "cache_aligned.h"
+
+namespace bdm {
+
+// Live population counters that can be read while a timestep is running.
+//
+// Every OpenMP thread updates its own shard, so the biology modules never
+// contend for a cache line. A reader sums the shards, which costs
+// O(threads), independent of the number of cells. All counters are
+// relaxed atomics, so reading them from a monitoring thread is safe and
+// lock-free; a snapshot taken during a step is consistent per counter, not
+// across counters.
+//
+// A shard has a single writer, so a counter is incremented with a relaxed
+// load and store instead of a read-modify-write. The counters may only be
+// updated by the threads of an OpenMP team that is not larger than
+// omp_get_max_threads() at construction.
+//
+// Survivors are counted per step: a cell that is not removed in this step
+// counts as survivor. Call StartStep() between two timesteps to reset them.
+class PopulationCounters {
+ public:
+  struct Snapshot {
+    uint64_t births = 0;
+    uint64_t deaths = 0;
+    /// number of cells that survived the current step so far
+    uint64_t survivors = 0;
+  };
+
+  PopulationCounters()
+      : num_shards_(omp_get_max_threads()), shards_(num_shards_) {}
+
+  void RecordBirth() { Add(&GetShard()->births); }
+  void RecordDeath() { Add(&GetShard()->deaths); }
+  void RecordSurvivor() { Add(&GetShard()->survivors); }
+
+  /// Resets the survivor counts. Must not run concurrently with
+  /// RecordSurvivor().
+  void StartStep() {
+    for (size_t i = 0; i < num_shards_; i++) {
+      shards_[i].survivors.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  Snapshot Read() const {
+    Snapshot snapshot;
+    for (size_t i = 0; i < num_shards_; i++) {
+      snapshot.births += shards_[i].births.load(std::memory_order_relaxed);
+      snapshot.deaths += shards_[i].deaths.load(std::memory_order_relaxed);
+      snapshot.survivors +=
+          shards_[i].survivors.load(std::memory_order_relaxed);
+    }
+    return snapshot;
+  }
+
+
+ private:
+  struct Shard {
+    std::atomic<uint64_t> births{0};
+    std::atomic<uint64_t> deaths{0};
+    std::atomic<uint64_t> survivors{0};
+  };
+
+  size_t num_shards_;
+  /// one cache line per shard
+  CacheAlignedArray<Shard> shards_;
+
+  size_t ShardIndex() const {
+    const size_t shard = omp_get_thread_num();
+    if (shard >= num_shards_) {
+      // two threads must never write the same shard
+      Log::Fatal("PopulationCounters", "Thread ", shard,
+                 " of a team larger than the ", num_shards_,
+                 " threads at construction");
+    }
+    return shard;
+  }
+
+  Shard* GetShard() { return &shards_[ShardIndex()]; }
+
+  /// Only the thread of the shard writes the counter, and readers only need
+  /// an untorn value, so no read-modify-write (lock prefix) is needed
+  static void Add(std::atomic<uint64_t>* counter) {
+    counter->store(counter->load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+  }
+};
+
+// Calls `report` every `interval` seconds from a background thread until the
+// monitor is destroyed.
+class PopulationMonitor {
+ public:
+  PopulationMonitor(double interval, std::function<void()> report)
+      : thread_([this, interval, report]() {
+          std::unique_lock<std::mutex> lock(mutex_);
+          auto period = std::chrono::duration<double>(interval);
+          while (!stop_.wait_for(lock, period, [this] { return stopped_; })) {
+            report();
+          }
+        }) {}
+
+  ~PopulationMonitor() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopped_ = true;
+    }
+    stop_.notify_one();
+    thread_.join();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable stop_;
+  bool stopped_ = false;
+  /// declared last, so it starts after the other members are initialized
+  std::thread thread_;
+};
+
+}  // namespace bdm
+
+#endif  // COMMON_POPULATION_COUNTERS_H_
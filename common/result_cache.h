@@ -0,0 +1,121 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#ifndef COMMON_RESULT_CACHE_H_
+#define COMMON_RESULT_CACHE_H_
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "biodynamo.h"
+
+namespace bdm {
+
+/// 64 bit FNV-1a hash of a sequence of values
+class Fnv1aHash {
+ public:
+  Fnv1aHash& Add(const void* data, size_t size) {
+    auto* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+      hash_ = (hash_ ^ bytes[i]) * 1099511628211ull;
+    }
+    return *this;
+  }
+
+  /// Numbers and enums are hashed bytewise
+  template <typename T>
+  Fnv1aHash& Add(const T& value) {
+    static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value,
+                  "Add(const void*, size_t) for other types");
+    return Add(&value, sizeof(T));
+  }
+
+  /// Length first, so ("ab", "c") and ("a", "bc") differ
+  Fnv1aHash& Add(const std::string& value) {
+    Add(value.size());
+    return Add(value.data(), value.size());
+  }
+
+  template <typename T>
+  Fnv1aHash& Add(const std::vector<T>& values) {
+    Add(values.size());
+    for (auto& value : values) {
+      Add(value);
+    }
+    return *this;
+  }
+
+  uint64_t Get() const { return hash_; }
+
+ private:
+  uint64_t hash_ = 14695981039346656037ull;
+};
+
+// Results of finished simulations on disk, addressed by a hash of everything
+// that determines the result (scenario parameters, model version, ...).
+// A result is stored as text in <dir>/<key>.result. It is written to a
+// temporary file first and then renamed, so concurrent runs of a sweep never
+// read a partial result.
+class ResultCache {
+ public:
+  explicit ResultCache(const std::string& dir) : dir_(dir) {
+    mkdir(dir_.c_str(), 0755);
+  }
+
+  /// Returns false on a miss
+  bool Load(uint64_t key, std::string* result) const {
+    std::ifstream ifs(GetFile(key));
+    if (!ifs) {
+      return false;
+    }
+    std::stringstream content;
+    content << ifs.rdbuf();
+    *result = content.str();
+    return true;
+  }
+
+  void Store(uint64_t key, const std::string& result) const {
+    std::string file = GetFile(key);
+    std::string tmp = file + ".tmp" + std::to_string(getpid());
+    {
+      std::ofstream ofs(tmp);
+      ofs << result;
+      if (!ofs) {
+        Log::Warning("ResultCache::Store", "Could not write ", tmp);
+        return;
+      }
+    }
+    rename(tmp.c_str(), file.c_str());
+  }
+
+  std::string GetFile(uint64_t key) const {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.result",
+             static_cast<unsigned long long>(key));
+    return dir_ + "/" + name;
+  }
+
+ private:
+  std::string dir_;
+};
+
+}  // namespace bdm
+
+#endif  // COMMON_RESULT_CACHE_H_
@@ -0,0 +1,65 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#ifndef COMMON_RUN_RESULT_H_
+#define COMMON_RUN_RESULT_H_
+
+#include <chrono>
+#include <vector>
+
+#include "biodynamo.h"
+
+namespace bdm {
+
+// Building blocks of the results that the projects return to a driver which
+// runs many scenarios in one process, instead of printing them.
+
+/// Wall-clock times of one run in seconds
+struct RunTimings {
+  /// until the first timestep (simulation, substances and cells created)
+  double setup = 0;
+  /// every timestep
+  std::vector<double> steps;
+  /// the whole run
+  double total = 0;
+};
+
+/// Seconds since construction or the last Restart()
+class Stopwatch {
+ public:
+  Stopwatch() : start_(std::chrono::steady_clock::now()) {}
+
+  void Restart() { start_ = std::chrono::steady_clock::now(); }
+
+  double Seconds() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start_)
+        .count();
+  }
+
+ private:
+  std::chrono::steady_clock::time_point start_;
+};
+
+/// Positions of all simulation objects, in the order of the ResourceManager
+inline std::vector<Double3> CollectPositions(ResourceManager* rm) {
+  std::vector<Double3> positions;
+  positions.reserve(rm->GetNumSimObjects());
+  rm->ApplyOnAllElements(
+      [&](SimObject* so) { positions.push_back(so->GetPosition()); });
+  return positions;
+}
+
+}  // namespace bdm
+
+#endif  // COMMON_RUN_RESULT_H_
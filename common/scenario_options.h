@@ -0,0 +1,275 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#ifndef COMMON_SCENARIO_OPTIONS_H_
+#define COMMON_SCENARIO_OPTIONS_H_
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "biodynamo.h"
+#include "command_line.h"
+#include "cpptoml/cpptoml.h"
+
+namespace bdm {
+
+/// The configuration file that Simulation reads: bdm.toml in the working
+/// directory or, if there is none, in its parent (e.g. when the program is
+/// started from build/). Empty if neither exists.
+inline std::string FindConfigFile() {
+  for (const char* file : {"bdm.toml", "../bdm.toml"}) {
+    if (std::ifstream(file)) {
+      return file;
+    }
+  }
+  return "";
+}
+
+// Scenario parameters of a project.
+// A parameter is read from the command line flag --<name>=<value> or, if the
+// flag is not given, from the [scenario] section of bdm.toml (see
+// FindConfigFile):
+//
+//   [scenario]
+//   cell_count = 10000
+//   report_steps = [24, 72]
+//
+// Values are validated when they are read; an invalid value stops the
+// program with a message that names the parameter. After all parameters are
+// read, CheckAllUsed() stops the program if bdm.toml or the command line
+// contains a parameter that does not exist (e.g. a typo).
+class ScenarioOptions {
+ public:
+  /// The flags of all parameters that are read are removed from argv, so the
+  /// remaining arguments can be passed to Simulation.
+  ScenarioOptions(int* argc, const char** argv,
+                  const std::string& config_file = FindConfigFile())
+      : argc_(argc), argv_(argv) {
+    if (config_file.empty() || !std::ifstream(config_file)) {
+      return;
+    }
+    auto config = cpptoml::parse_file(config_file);
+    auto table = config->get_table("scenario");
+    if (!table) {
+      return;
+    }
+    for (auto& entry : *table) {
+      config_[entry.first] = ToText(entry.first, entry.second);
+    }
+  }
+
+  int64_t GetInt(const std::string& name, int64_t default_value, int64_t min,
+                 int64_t max) {
+    std::string text;
+    if (!Lookup(name, &text)) {
+      return default_value;
+    }
+    int64_t value = ParseInt(name, text);
+    CheckRange(name, value, min, max);
+    return value;
+  }
+
+  double GetDouble(const std::string& name, double default_value, double min,
+                   double max) {
+    std::string text;
+    if (!Lookup(name, &text)) {
+      return default_value;
+    }
+    double value = ParseDouble(name, text);
+    CheckRange(name, value, min, max);
+    return value;
+  }
+
+  /// true / false (TOML booleans), 1 / 0; a flag without value
+  /// (--<name>) is true
+  bool GetBool(const std::string& name, bool default_value) {
+    std::string text;
+    if (!Lookup(name, &text)) {
+      return default_value;
+    }
+    if (text == "true" || text == "1" || text.empty()) {
+      return true;
+    }
+    if (text != "false" && text != "0") {
+      Log::Fatal("ScenarioOptions", "Parameter ", name,
+                 " must be true or false, got '", text, "'");
+    }
+    return false;
+  }
+
+  std::string GetString(const std::string& name,
+                        const std::string& default_value) {
+    std::string text;
+    return Lookup(name, &text) ? text : default_value;
+  }
+
+  /// Comma separated on the command line (--report_steps=24,72), an array in
+  /// bdm.toml
+  std::vector<int64_t> GetIntList(const std::string& name,
+                                  const std::vector<int64_t>& default_value,
+                                  int64_t min, int64_t max) {
+    std::string text;
+    if (!Lookup(name, &text)) {
+      return default_value;
+    }
+    std::vector<int64_t> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+      values.push_back(ParseInt(name, item));
+      CheckRange(name, values.back(), min, max);
+    }
+    if (values.empty()) {
+      Log::Fatal("ScenarioOptions", "Parameter ", name, " is empty");
+    }
+    return values;
+  }
+
+  /// Returns true if the parameter is given on the command line or in
+  /// bdm.toml (without removing the flag).
+  bool Has(const std::string& name) const {
+    if (config_.find(name) != config_.end()) {
+      return true;
+    }
+    const std::string flag = "--" + name;
+    for (int i = 1; i < *argc_; i++) {
+      std::string arg = argv_[i];
+      if (arg == flag || arg.compare(0, flag.size() + 1, flag + "=") == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Stops the program if a parameter of the [scenario] section was not
+  /// read, or if a flag --<name> or --<name>=<value> is left that Simulation
+  /// does not know either. Call after reading all parameters.
+  void CheckAllUsed() const {
+    for (auto& entry : config_) {
+      if (read_.find(entry.first) == read_.end()) {
+        Log::Fatal("ScenarioOptions", "Unknown parameter ", entry.first,
+                   " in the [scenario] section");
+      }
+    }
+    // the options of Simulation; their values may also follow as the next
+    // argument (--backup <file>)
+    static const std::set<std::string> kSimulationFlags = {
+        "backup", "restore", "inline-config", "help", "version"};
+    for (int i = 1; i < *argc_; i++) {
+      std::string arg = argv_[i];
+      if (arg.size() <= 2 || arg.compare(0, 2, "--") != 0) {
+        continue;
+      }
+      std::string name = arg.substr(2, arg.find('=') - 2);
+      if (kSimulationFlags.find(name) == kSimulationFlags.end()) {
+        Log::Fatal("ScenarioOptions", "Unknown parameter --", name);
+      }
+    }
+  }
+
+ private:
+  int* argc_;
+  const char** argv_;
+  /// values of the [scenario] section as text
+  std::map<std::string, std::string> config_;
+  /// names of all parameters that were read (see CheckAllUsed)
+  std::set<std::string> read_;
+
+  bool Lookup(const std::string& name, std::string* text) {
+    read_.insert(name);
+    if (ExtractOption(name, argc_, argv_, text)) {
+      return true;
+    }
+    auto it = config_.find(name);
+    if (it == config_.end()) {
+      return false;
+    }
+    *text = it->second;
+    return true;
+  }
+
+  static std::string ToText(const std::string& name,
+                            const std::shared_ptr<cpptoml::base>& value) {
+    if (value->is_array()) {
+      std::string text;
+      for (auto& item : value->as_array()->get()) {
+        text += (text.empty() ? "" : ",") + ToText(name, item);
+      }
+      return text;
+    }
+    if (auto v = value->as<std::string>()) {
+      return v->get();
+    }
+    if (auto v = value->as<int64_t>()) {
+      return std::to_string(v->get());
+    }
+    if (auto v = value->as<double>()) {
+      std::stringstream stream;
+      stream.precision(17);
+      stream << v->get();
+      return stream.str();
+    }
+    if (auto v = value->as<bool>()) {
+      return v->get() ? "true" : "false";
+    }
+    Log::Fatal("ScenarioOptions", "Unsupported type of parameter ", name);
+    return "";
+  }
+
+  static int64_t ParseInt(const std::string& name, const std::string& text) {
+    size_t end = 0;
+    int64_t value = 0;
+    try {
+      value = std::stoll(text, &end);
+    } catch (const std::exception&) {
+      end = 0;
+    }
+    if (end == 0 || end != text.size()) {
+      Log::Fatal("ScenarioOptions", "Parameter ", name,
+                 " must be an integer, got '", text, "'");
+    }
+    return value;
+  }
+
+  static double ParseDouble(const std::string& name, const std::string& text) {
+    size_t end = 0;
+    double value = 0;
+    try {
+      value = std::stod(text, &end);
+    } catch (const std::exception&) {
+      end = 0;
+    }
+    if (end == 0 || end != text.size()) {
+      Log::Fatal("ScenarioOptions", "Parameter ", name,
+                 " must be a number, got '", text, "'");
+    }
+    return value;
+  }
+
+  template <typename T>
+  static void CheckRange(const std::string& name, T value, T min, T max) {
+    if (value < min || value > max) {
+      Log::Fatal("ScenarioOptions", "Parameter ", name, " = ", value,
+                 " is out of range [", min, ", ", max, "]");
+    }
+  }
+};
+
+}  // namespace bdm
+
+#endif  // COMMON_SCENARIO_OPTIONS_H_
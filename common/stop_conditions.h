@@ -0,0 +1,169 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#ifndef COMMON_STOP_CONDITIONS_H_
+#define COMMON_STOP_CONDITIONS_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <utility>
+
+#include "scenario_options.h"
+
+namespace bdm {
+
+/// Why a simulation ended. Ordered by priority: if several conditions hold
+/// at the same timestep, the largest one is reported.
+enum class StopReason : int {
+  kCompleted = 0,
+  kSteadyState,
+  kPopulationThreshold,
+  kExtinction,
+  kTimeBudget,
+};
+
+inline const char* StopReasonName(StopReason reason) {
+  switch (reason) {
+    case StopReason::kCompleted: return "completed";
+    case StopReason::kSteadyState: return "steady state";
+    case StopReason::kPopulationThreshold: return "population threshold";
+    case StopReason::kExtinction: return "extinction";
+    case StopReason::kTimeBudget: return "time budget";
+  }
+  return "unknown";
+}
+
+/// Conditions that end a simulation before its last timestep.
+/// All are disabled by default except extinction.
+struct StopConditions {
+  /// stop when no cell is left
+  bool extinction = true;
+  /// stop when the population reaches max_population (0: disabled)
+  uint64_t max_population = 0;
+  /// stop when the population stayed within steady_state_epsilon (relative,
+  /// largest minus smallest population) during the last steady_state_steps
+  /// timesteps (0: disabled)
+  double steady_state_epsilon = 0;
+  uint64_t steady_state_steps = 0;
+  /// wall-clock budget in seconds (0: disabled)
+  double time_budget = 0;
+
+  /// Reads the conditions from the stop_* parameters of the scenario
+  static StopConditions FromOptions(ScenarioOptions* options) {
+    StopConditions conditions;
+    conditions.extinction =
+        options->GetBool("stop_on_extinction", conditions.extinction);
+    conditions.max_population = options->GetInt(
+        "stop_max_population", conditions.max_population, 0, INT64_MAX);
+    conditions.steady_state_epsilon = options->GetDouble(
+        "stop_steady_state_epsilon", conditions.steady_state_epsilon, 0, 1);
+    conditions.steady_state_steps = options->GetInt(
+        "stop_steady_state_steps", conditions.steady_state_steps, 0, 1e7);
+    conditions.time_budget = options->GetDouble(
+        "stop_time_budget", conditions.time_budget, 0, 1e9);
+    return conditions;
+  }
+};
+
+// Evaluates the StopConditions after every timestep.
+// Check() is amortized O(1); it only needs the current number of cells.
+// The smallest and largest population of the steady state window are kept
+// in monotonic queues.
+class StopMonitor {
+ public:
+  explicit StopMonitor(const StopConditions& conditions)
+      : conditions_(conditions), start_(std::chrono::steady_clock::now()) {}
+
+  /// False if Check() does not need the number of cells, i.e. it does not
+  /// have to be computed (e.g. summed over all MPI ranks) every timestep.
+  bool NeedsPopulation() const {
+    return conditions_.extinction || conditions_.max_population != 0 ||
+           SteadyStateEnabled();
+  }
+
+  /// Call once after every timestep
+  StopReason Check(uint64_t population) {
+    StopReason reason = StopReason::kCompleted;
+    if (SteadyStateEnabled()) {
+      // the window are the timesteps [checks_ - steady_state_steps, checks_]
+      const uint64_t window = conditions_.steady_state_steps + 1;
+      Push(&min_, population, checks_, std::less_equal<uint64_t>());
+      Push(&max_, population, checks_, std::greater_equal<uint64_t>());
+      if (checks_ + 1 >= window) {
+        const uint64_t first = checks_ + 1 - window;
+        while (min_.front().second < first) {
+          min_.pop_front();
+        }
+        while (max_.front().second < first) {
+          max_.pop_front();
+        }
+        double smallest = min_.front().first;
+        double change =
+            (max_.front().first - smallest) / std::max(smallest, 1.0);
+        if (change < conditions_.steady_state_epsilon) {
+          reason = StopReason::kSteadyState;
+        }
+      }
+      checks_++;
+    }
+    if (conditions_.max_population != 0 &&
+        population >= conditions_.max_population) {
+      reason = StopReason::kPopulationThreshold;
+    }
+    if (conditions_.extinction && population == 0) {
+      reason = StopReason::kExtinction;
+    }
+    if (conditions_.time_budget > 0 &&
+        std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                      start_)
+                .count() >= conditions_.time_budget) {
+      reason = StopReason::kTimeBudget;
+    }
+    return reason;
+  }
+
+ private:
+  StopConditions conditions_;
+  std::chrono::steady_clock::time_point start_;
+  /// number of Check() calls so far
+  uint64_t checks_ = 0;
+  /// (population, check) of the window; populations increase (min_) or
+  /// decrease (max_) from the front, so the front is the extreme value
+  std::deque<std::pair<uint64_t, uint64_t>> min_;
+  std::deque<std::pair<uint64_t, uint64_t>> max_;
+
+  /// Appends `population` after dropping all entries that can no longer be
+  /// the extreme value of a window, because `population` is newer and at
+  /// least as extreme.
+  template <typename Compare>
+  static void Push(std::deque<std::pair<uint64_t, uint64_t>>* queue,
+                   uint64_t population, uint64_t check, Compare extreme) {
+    while (!queue->empty() && extreme(population, queue->back().first)) {
+      queue->pop_back();
+    }
+    queue->emplace_back(population, check);
+  }
+
+  bool SteadyStateEnabled() const {
+    return conditions_.steady_state_epsilon > 0 &&
+           conditions_.steady_state_steps > 0;
+  }
+};
+
+}  // namespace bdm
+
+#endif  // COMMON_STOP_CONDITIONS_H_
@@ -0,0 +1,218 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#ifndef COMMON_TRACE_H_
+#define COMMON_TRACE_H_
+
+#include <omp.h>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "biodynamo.h"
+#include "cache_aligned.h"
+
+namespace bdm {
+
+// Timeline of the stages of a simulation per OpenMP thread, written in the
+// Chrome trace format (open it with chrome://tracing or ui.perfetto.dev).
+//
+// Every thread records into its own ring buffer (one per thread of
+// omp_get_max_threads() at Enable(), aligned to cache lines), so recording
+// needs no synchronization; when a buffer is full the oldest spans are
+// overwritten.
+//
+// Only code of the projects is recorded. The stages inside a step of the
+// BioDynaMo scheduler (neighbor grid update, mechanics) are part of the
+// span around Scheduler::Simulate, see Extend().
+// While the tracer is disabled (the default) a TraceSpan only reads one
+// bool.
+//
+// Span names must be string literals: only the pointer is stored.
+class Tracer {
+ public:
+  static Tracer* Get() {
+    static Tracer tracer;
+    return &tracer;
+  }
+
+  /// Starts recording with room for `capacity` spans per thread
+  void Enable(size_t capacity = 1 << 16) {
+    buffers_.Assign(omp_get_max_threads(), Buffer());
+    for (size_t t = 0; t < buffers_.size(); t++) {
+      buffers_[t].spans.resize(capacity);
+    }
+    start_ = std::chrono::steady_clock::now();
+    enabled_ = true;
+  }
+
+  bool IsEnabled() const { return enabled_; }
+
+  /// Nanoseconds since Enable()
+  uint64_t Now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - start_)
+        .count();
+  }
+
+  void Record(const char* name, uint64_t begin, uint64_t end) {
+    Push(GetBuffer(), {name, begin, end});
+  }
+
+  /// Extends the open span `name` of this thread to now, or opens it.
+  /// Used for work that runs once per cell: consecutive calls of one thread
+  /// are merged into one span per timestep, which shows the load balance
+  /// without recording every cell.
+  /// The span covers everything the thread did between its first and its
+  /// last call. For a biology module this includes the mechanics of the
+  /// cells: the scheduler of BioDynaMo runs the biology modules and the
+  /// mechanics of an agent in the same loop over the agents.
+  void Extend(const char* name) {
+    Buffer* buffer = GetBuffer();
+    uint64_t now = Now();
+    if (buffer->open.name != name) {
+      if (buffer->open.name != nullptr) {
+        Push(buffer, buffer->open);
+      }
+      buffer->open = {name, now, now};
+    }
+    buffer->open.end = now;
+  }
+
+  /// Closes the spans opened by Extend(). Call between two timesteps.
+  void CloseSpans() {
+    for (size_t t = 0; t < buffers_.size(); t++) {
+      auto& buffer = buffers_[t];
+      if (buffer.open.name != nullptr) {
+        Push(&buffer, buffer.open);
+        buffer.open = Span();
+      }
+    }
+  }
+
+  /// Writes all recorded spans as Chrome trace JSON and clears the buffers.
+  /// `pid` distinguishes processes, e.g. MPI ranks.
+  void Write(const std::string& filename, int pid = 0) {
+    CloseSpans();
+    std::ofstream ofs(filename);
+    if (!ofs) {
+      Log::Warning("Tracer::Write", "Could not write ", filename);
+      return;
+    }
+    ofs << "{\"traceEvents\":[\n";
+    bool first = true;
+    for (size_t tid = 0; tid < buffers_.size(); tid++) {
+      auto& buffer = buffers_[tid];
+      const size_t size = buffer.spans.size();
+      const size_t count = buffer.wrapped ? size : buffer.next;
+      // oldest first
+      for (size_t i = 0; i < count; i++) {
+        const auto& span =
+            buffer.spans[buffer.wrapped ? (buffer.next + i) % size : i];
+        ofs << (first ? "" : ",\n") << "{\"name\":\"" << span.name
+            << "\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << tid
+            << ",\"ts\":" << span.begin / 1000.0
+            << ",\"dur\":" << (span.end - span.begin) / 1000.0 << "}";
+        first = false;
+      }
+      buffer.next = 0;
+      buffer.wrapped = false;
+    }
+    ofs << "\n]}\n";
+  }
+
+ private:
+  struct Span {
+    const char* name = nullptr;
+    uint64_t begin = 0;
+    uint64_t end = 0;
+  };
+
+  struct Buffer {
+    std::vector<Span> spans;
+    size_t next = 0;
+    bool wrapped = false;
+    /// span of Extend()
+    Span open;
+  };
+
+  bool enabled_ = false;
+  std::chrono::steady_clock::time_point start_;
+  CacheAlignedArray<Buffer> buffers_;
+
+  Buffer* GetBuffer() {
+    const size_t thread = omp_get_thread_num();
+    if (thread >= buffers_.size()) {
+      // two threads must never share a buffer
+      Log::Fatal("Tracer", "Thread ", thread, " of a team larger than the ",
+                 buffers_.size(), " threads at Tracer::Enable()");
+    }
+    return &buffers_[thread];
+  }
+
+  static void Push(Buffer* buffer, const Span& span) {
+    buffer->spans[buffer->next] = span;
+    if (++buffer->next == buffer->spans.size()) {
+      buffer->next = 0;
+      buffer->wrapped = true;
+    }
+  }
+};
+
+/// Records the time until the end of the scope as span `name`
+class TraceSpan {
+ public:
+  explicit TraceSpan(const char* name) {
+    if (Tracer::Get()->IsEnabled()) {
+      name_ = name;
+      begin_ = Tracer::Get()->Now();
+    }
+  }
+
+  ~TraceSpan() {
+    if (name_ != nullptr) {
+      Tracer::Get()->Record(name_, begin_, Tracer::Get()->Now());
+    }
+  }
+
+ private:
+  const char* name_ = nullptr;
+  uint64_t begin_ = 0;
+};
+
+/// Adds the time until the end of the scope to the open span `name` of this
+/// thread (see Tracer::Extend)
+class TraceExtend {
+ public:
+  explicit TraceExtend(const char* name) {
+    if (Tracer::Get()->IsEnabled()) {
+      name_ = name;
+      Tracer::Get()->Extend(name);
+    }
+  }
+
+  ~TraceExtend() {
+    if (name_ != nullptr) {
+      Tracer::Get()->Extend(name_);
+    }
+  }
+
+ private:
+  const char* name_ = nullptr;
+};
+
+}  // namespace bdm
+
+#endif  // COMMON_TRACE_H_
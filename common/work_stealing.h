@@ -0,0 +1,189 @@
+// -----------------------------------------------------------------------------
+//
+// Copyright (C) The BioDynaMo Project.
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+//
+// See the LICENSE file distributed with this work for details.
+// See the NOTICE file distributed with this work for additional information
+// regarding copyright ownership.
+//
+// -----------------------------------------------------------------------------
+#ifndef COMMON_WORK_STEALING_H_
+#define COMMON_WORK_STEALING_H_
+
+#include <omp.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cache_aligned.h"
+
+namespace bdm {
+
+// Parallel loop over chunks of items with work stealing.
+//
+// The items are split into chunks with the same number of items. The cost
+// of a chunk is not known in advance (e.g. how many of its cells divide),
+// so the balance comes from stealing, not from the chunk sizes. Every thread
+// starts with a contiguous range of chunks and takes them from the front; a
+// thread that runs out steals chunks from the back of the range of another
+// thread.
+// So a thread whose cells are expensive (dense regions, many divisions)
+// does not hold up the others, and neighboring chunks stay on one thread as
+// long as there is no imbalance.
+//
+// The chunks do not depend on timings, only which thread runs a chunk does.
+// Bodies that write their output per chunk and draw their random numbers
+// per item (see CounterRandom) give the same result on any number of
+// threads.
+//
+// The busy time of every thread is recorded, see GetUtilization().
+class WorkStealingFor {
+ public:
+  /// Chunks per thread; more chunks balance better but cost more steals
+  static constexpr size_t kChunksPerThread = 8;
+
+  WorkStealingFor()
+      : num_threads_(omp_get_max_threads()),
+        ranges_(num_threads_),
+        busy_(num_threads_, 0),
+        chunks_(num_threads_, 0),
+        steals_(num_threads_, 0) {}
+
+  /// Chunks with the same number of items
+  std::vector<size_t> MakeChunks(size_t num_items) const {
+    const size_t num_chunks =
+        std::max<size_t>(1, std::min(num_items, num_threads_ * kChunksPerThread));
+    std::vector<size_t> bounds(num_chunks + 1);
+    for (size_t c = 0; c <= num_chunks; c++) {
+      bounds[c] = num_items * c / num_chunks;
+    }
+    return bounds;
+  }
+
+  /// Calls `body(chunk, begin, end)` for every chunk of `bounds` in parallel.
+  /// Must not be called from a parallel region.
+  template <typename Body>
+  void Run(const std::vector<size_t>& bounds, Body body) {
+    const size_t num_chunks = bounds.size() - 1;
+    for (size_t t = 0; t < num_threads_; t++) {
+      uint64_t begin = num_chunks * t / num_threads_;
+      uint64_t end = num_chunks * (t + 1) / num_threads_;
+      ranges_[t].store(Pack(begin, end), std::memory_order_relaxed);
+    }
+
+    double start = omp_get_wtime();
+#pragma omp parallel num_threads(num_threads_)
+    {
+      const size_t self = omp_get_thread_num();
+      double busy = 0;
+      uint64_t chunks = 0;
+      uint64_t steals = 0;
+      uint64_t chunk;
+      while (true) {
+        bool stolen = false;
+        if (!PopFront(self, &chunk)) {
+          stolen = Steal(self, &chunk);
+          if (!stolen) {
+            break;
+          }
+        }
+        double chunk_start = omp_get_wtime();
+        body(chunk, bounds[chunk], bounds[chunk + 1]);
+        busy += omp_get_wtime() - chunk_start;
+        chunks++;
+        steals += stolen;
+      }
+      busy_[self] += busy;
+      chunks_[self] += chunks;
+      steals_[self] += steals;
+    }
+    wall_ += omp_get_wtime() - start;
+  }
+
+  /// Fraction of the wall-clock time of all Run() calls that thread `t` was
+  /// busy
+  double GetUtilization(size_t t) const {
+    return wall_ == 0 ? 0 : busy_[t] / wall_;
+  }
+
+  size_t GetNumThreads() const { return num_threads_; }
+
+  /// Prints the utilization of the threads and the number of steals
+  void PrintStatistics(const std::string& name) const {
+    double min = 1, max = 0, sum = 0;
+    uint64_t steals = 0;
+    for (size_t t = 0; t < num_threads_; t++) {
+      min = std::min(min, GetUtilization(t));
+      max = std::max(max, GetUtilization(t));
+      sum += GetUtilization(t);
+      steals += steals_[t];
+    }
+    std::cout << name << ": thread utilization min " << min * 100 << "%, mean "
+              << sum / num_threads_ * 100 << "%, max " << max * 100
+              << "% on " << num_threads_ << " threads, " << steals
+              << " chunks stolen" << std::endl;
+  }
+
+ private:
+  size_t num_threads_;
+  /// [begin, end) of the chunks of every thread, packed into one word so the
+  /// owner (front) and thieves (back) can update it with one CAS; one cache
+  /// line per thread
+  CacheAlignedArray<std::atomic<uint64_t>> ranges_;
+  std::vector<double> busy_;
+  std::vector<uint64_t> chunks_;
+  std::vector<uint64_t> steals_;
+  double wall_ = 0;
+
+  static uint64_t Pack(uint64_t begin, uint64_t end) {
+    return (begin << 32) | end;
+  }
+
+  bool PopFront(size_t t, uint64_t* chunk) {
+    auto& range = ranges_[t];
+    uint64_t value = range.load(std::memory_order_acquire);
+    while (true) {
+      uint64_t begin = value >> 32;
+      uint64_t end = value & 0xffffffff;
+      if (begin >= end) {
+        return false;
+      }
+      if (range.compare_exchange_weak(value, Pack(begin + 1, end),
+                                      std::memory_order_acq_rel)) {
+        *chunk = begin;
+        return true;
+      }
+    }
+  }
+
+  bool Steal(size_t self, uint64_t* chunk) {
+    for (size_t i = 1; i < num_threads_; i++) {
+      auto& range = ranges_[(self + i) % num_threads_];
+      uint64_t value = range.load(std::memory_order_acquire);
+      while (true) {
+        uint64_t begin = value >> 32;
+        uint64_t end = value & 0xffffffff;
+        if (begin >= end) {
+          break;
+        }
+        if (range.compare_exchange_weak(value, Pack(begin, end - 1),
+                                        std::memory_order_acq_rel)) {
+          *chunk = end - 1;
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+};
+
+}  // namespace bdm
+
+#endif  // COMMON_WORK_STEALING_H_